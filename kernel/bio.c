@@ -1,13 +1,43 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
 //
+// The cache gets 1/BCACHEDIV of the memory that is free at boot
+// (at least NBUF buffers), allocated with kalloc().
+//
+// Each hash bucket has its own lock, so lookups of different
+// blocks from different harts do not contend. A miss must
+// recycle a free buffer, which may live in any bucket;
+// bcache.lock serializes misses so that two of them cannot
+// insert the same block twice.
+//
+// Recycling follows 2Q, so that one long sequential read does
+// not flush blocks in real use. A block read in for the first
+// time is cold (the A1in queue); hits while it is cold do not
+// count, since they are usually the same read() working
+// through the block. When a cold block is recycled its number
+// is remembered in a ghost list (A1out). A block read again
+// while still in the ghost list was wanted twice over a long
+// span, and comes back hot (the Am queue). Cold blocks are
+// recycled in roughly FIFO order while there are more than
+// a quarter of the buffers cold; otherwise hot ones are, by
+// CLOCK (second chance). A single CLOCK hand serves for both.
+//
+// breadahead() starts reading blocks without waiting for them,
+// so that a sequential reader finds the next blocks already
+// in the cache (see seqread() in file.c). The buffers stay
+// locked, owned by the disk, until bdone() releases them.
+// It and bwritev() hand the disk up to NBATCH blocks at a
+// time, rather than one at a time as bread and bwrite do,
+// through the elevator in iosched.c.
+//
 // Interface:
 // * To get a buffer for a particular disk block, call bread.
-// * After changing buffer data, call bwrite to write it to disk.
+// * After changing buffer data, call bwrite to write it to disk,
+//     or bwritev for several buffers at once.
 // * When done with the buffer, call brelse.
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
@@ -22,72 +52,296 @@
 #include "defs.h"
 #include "fs.h"
 #include "buf.h"
+#include "iostat.h"
 
-struct {
+#ifndef BCACHEDIV
+#define BCACHEDIV 32  // share of free memory; build with BCACHEDIV=n to change
+#endif
+
+#define NBUCKET 13    // prime, to spread consecutive block numbers
+#define NGHOST  1024  // most blocks remembered in A1out
+#define NGHASH  256   // hash chains over the A1out ring
+
+struct bucket {
   struct spinlock lock;
-  struct buf buf[NBUF];
+  struct buf *head;     // buffers hashed here, through next
+  uint64 hits;
+  uint64 aheads;        // reads started by breadahead()
+  uint64 aheadhits;     // ... whose block was then asked for
+};
+
+struct ghost {
+  uint dev;             // 0 if unused
+  uint blockno;
+  short next;           // next in its ghash chain, or -1
+};
 
-  // Linked list of all buffers, through prev/next.
-  // Sorted by how recently the buffer was used.
-  // head.next is most recent, head.prev is least.
-  struct buf head;
+struct {
+  struct spinlock lock; // held while recycling a buffer
+  int nbuf;
+  struct buf *hand;     // CLOCK hand, on the ring through clocknext
+  int nin;              // cold buffers (A1in)
+  int kin;              // cold buffers wanted at most
+  struct ghost ghost[NGHOST]; // A1out, a ring
+  int nghost;           // ring size in use
+  int ghostpos;         // next slot to overwrite
+  short ghash[NGHASH];  // in-use ghost slots by block, or -1
+  uint64 misses, promotions, recycled;
+  struct bucket bucket[NBUCKET];
 } bcache;
 
+static struct bucket*
+bhash(uint dev, uint blockno)
+{
+  return &bcache.bucket[(dev * 31 + blockno) % NBUCKET];
+}
+
 void
 binit(void)
 {
-  struct buf *b;
+  struct buf *b, *last = 0;
+  struct bucket *bk;
+  char *hp = 0, *dp = 0;
+  uint64 hleft = 0, dleft = 0;
+  int n;
 
   initlock(&bcache.lock, "bcache");
+  for(bk = bcache.bucket; bk < bcache.bucket+NBUCKET; bk++)
+    initlock(&bk->lock, "bcache.bucket");
+  for(int i = 0; i < NGHASH; i++)
+    bcache.ghash[i] = -1;
+
+  n = freemem() * 1024 / BCACHEDIV / (BSIZE + sizeof(struct buf));
+  if(n < NBUF)
+    n = NBUF;
 
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
-  for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
+  // Carve headers and data blocks out of whole pages.
+  for(int i = 0; i < n; i++){
+    if(hleft < sizeof(struct buf)){
+      if((hp = kalloc()) == 0)
+        break;
+      hleft = PGSIZE;
+    }
+    if(dleft < BSIZE){
+      if((dp = kalloc()) == 0)
+        break;
+      dleft = PGSIZE;
+    }
+    b = (struct buf*)hp;
+    hp += sizeof(struct buf);
+    hleft -= sizeof(struct buf);
+    memset(b, 0, sizeof(*b));
+    b->data = (uchar*)dp;
+    dp += BSIZE;
+    dleft -= BSIZE;
     initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+
+    // Empty buffers are cold, and each has its own block
+    // number on the unused device 0 so they hash evenly.
+    b->blockno = i;
+    bk = bhash(b->dev, b->blockno);
+    b->next = bk->head;
+    bk->head = b;
+    if(last)
+      last->clocknext = b;
+    else
+      bcache.hand = b;
+    last = b;
+    bcache.nbuf++;
   }
+  if(bcache.nbuf < NBUF)
+    panic("binit: no memory");
+  last->clocknext = bcache.hand;
+  bcache.nin = bcache.nbuf;
+  bcache.kin = bcache.nbuf / 4;
+  bcache.nghost = bcache.nbuf / 2;
+  if(bcache.nghost > NGHOST)
+    bcache.nghost = NGHOST;
 }
 
-// Look through buffer cache for block on device dev.
-// If not found, allocate a buffer.
-// In either case, return locked buffer.
+// Find block in bucket bk and take a reference to it.
+// Caller must hold bk->lock.
 static struct buf*
-bget(uint dev, uint blockno)
+bfind(struct bucket *bk, uint dev, uint blockno)
 {
   struct buf *b;
 
-  acquire(&bcache.lock);
-
-  // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+  for(b = bk->head; b; b = b->next){
     if(b->dev == dev && b->blockno == blockno){
       b->refcnt++;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
+      b->ref = 1;
+      bk->hits++;
+      if(b->ahead){
+        b->ahead = 0;
+        bk->aheadhits++;
+      }
       return b;
     }
   }
+  return 0;
+}
 
-  // Not cached.
-  // Recycle the least recently used (LRU) unused buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
-      return b;
+// The ghost hash chain for a block. Every miss looks here,
+// so it must not scan the whole ring.
+static short*
+ghostchain(uint dev, uint blockno)
+{
+  return &bcache.ghash[(dev * 31 + blockno) % NGHASH];
+}
+
+// Take ghost slot i off its chain and free it.
+// Caller must hold bcache.lock.
+static void
+ghostdel(int i)
+{
+  struct ghost *g = &bcache.ghost[i];
+  short *pp;
+
+  for(pp = ghostchain(g->dev, g->blockno); *pp != i; pp = &bcache.ghost[*pp].next)
+    ;
+  *pp = g->next;
+  g->dev = 0;
+}
+
+// Is the block in the ghost list? If so, forget it there.
+// Caller must hold bcache.lock.
+static int
+ghosthit(uint dev, uint blockno)
+{
+  for(int i = *ghostchain(dev, blockno); i >= 0; i = bcache.ghost[i].next){
+    if(bcache.ghost[i].dev == dev && bcache.ghost[i].blockno == blockno){
+      ghostdel(i);
+      return 1;
     }
   }
+  return 0;
+}
+
+// Remember a cold block that is being recycled, in place of
+// the oldest one. Caller must hold bcache.lock.
+static void
+ghostadd(uint dev, uint blockno)
+{
+  struct ghost *g;
+  short *pp;
+
+  if(dev == 0 || bcache.nghost == 0)
+    return;
+  g = &bcache.ghost[bcache.ghostpos];
+  if(g->dev)
+    ghostdel(bcache.ghostpos);
+  g->dev = dev;
+  g->blockno = blockno;
+  pp = ghostchain(dev, blockno);
+  g->next = *pp;
+  *pp = bcache.ghostpos;
+  bcache.ghostpos = (bcache.ghostpos + 1) % bcache.nghost;
+}
+
+// Choose a free buffer to recycle, take it out of its bucket
+// and return it with refcnt 1. Caller must hold bcache.lock.
+static struct buf*
+brecycle(void)
+{
+  struct buf *b, **pp;
+  struct bucket *bk;
+  int pass;
+
+  for(int i = 0; i < 3 * bcache.nbuf; i++){
+    b = bcache.hand;
+    bcache.hand = b->clocknext;
+    pass = i / bcache.nbuf;
+
+    // Peek without the bucket lock; checked again below.
+    if(b->refcnt != 0)
+      continue;
+    if(pass < 2){
+      if(bcache.nin > bcache.kin){
+        if(b->hot)
+          continue;
+      } else if(!b->hot){
+        continue;
+      } else if(b->ref){
+        b->ref = 0;
+        continue;
+      }
+    }
+    // After two passes, take any free buffer.
+
+    bk = bhash(b->dev, b->blockno);
+    acquire(&bk->lock);
+    if(b->refcnt != 0){
+      release(&bk->lock);
+      continue;
+    }
+    for(pp = &bk->head; *pp != b; pp = &(*pp)->next)
+      ;
+    *pp = b->next;
+    b->refcnt = 1;
+    release(&bk->lock);
+
+    if(!b->hot){
+      bcache.nin--;
+      ghostadd(b->dev, b->blockno);
+    }
+    bcache.recycled++;
+    return b;
+  }
   panic("bget: no buffers");
 }
 
+// Look through buffer cache for block on device dev.
+// If not found, allocate a buffer.
+// In either case, return locked buffer.
+static struct buf*
+bget(uint dev, uint blockno)
+{
+  struct bucket *bk = bhash(dev, blockno);
+  struct buf *b;
+
+  // Is the block already cached?
+  acquire(&bk->lock);
+  b = bfind(bk, dev, blockno);
+  release(&bk->lock);
+  if(b){
+    acquiresleep(&b->lock);
+    return b;
+  }
+
+  // Not cached. Only one miss at a time from here on;
+  // another may have brought the block in meanwhile.
+  acquire(&bcache.lock);
+  acquire(&bk->lock);
+  b = bfind(bk, dev, blockno);
+  release(&bk->lock);
+  if(b){
+    release(&bcache.lock);
+    acquiresleep(&b->lock);
+    return b;
+  }
+  bcache.misses++;
+
+  b = brecycle();
+  b->dev = dev;
+  b->blockno = blockno;
+  b->valid = 0;
+  b->ref = 0;
+  b->hot = ghosthit(dev, blockno);
+  if(b->hot)
+    bcache.promotions++;
+  else
+    bcache.nin++;
+
+  acquire(&bk->lock);
+  b->next = bk->head;
+  bk->head = b;
+  release(&bk->lock);
+  release(&bcache.lock);
+
+  acquiresleep(&b->lock);
+  return b;
+}
+
 // Return a locked buf with the contents of the indicated block.
 struct buf*
 bread(uint dev, uint blockno)
@@ -102,6 +356,84 @@ bread(uint dev, uint blockno)
   return b;
 }
 
+// Called by the disk driver, in interrupt context, when a
+// read started by breadahead() is done. Unlock and release
+// the buffer on behalf of the process that started it.
+static void
+bdone(struct buf *b)
+{
+  struct bucket *bk = bhash(b->dev, b->blockno);
+
+  b->done = 0;
+  b->valid = 1;
+  releasesleep(&b->lock);
+
+  acquire(&bk->lock);
+  b->refcnt--;
+  release(&bk->lock);
+}
+
+// Return a locked buf for the indicated block without
+// reading it from disk, for a caller that will overwrite
+// all of it.
+struct buf*
+bgetnew(uint dev, uint blockno)
+{
+  struct buf *b;
+
+  b = bget(dev, blockno);
+  b->valid = 1;
+  return b;
+}
+
+// Start reading those of the n indicated blocks that are not
+// cached into the cache, all at once, and return without
+// waiting for them. Blocks the disk has no room for are left
+// to be read when they are asked for. n is at most NBATCH.
+void
+breadahead(uint dev, uint *blocks, int n)
+{
+  struct buf *b, *bv[NBATCH];
+  struct bucket *bk;
+  int i, m = 0, started;
+
+  for(i = 0; i < n; i++){
+    bk = bhash(dev, blocks[i]);
+    acquire(&bk->lock);
+    for(b = bk->head; b; b = b->next)
+      if(b->dev == dev && b->blockno == blocks[i])
+        break;
+    release(&bk->lock);
+    if(b)
+      continue;
+
+    b = bget(dev, blocks[i]);
+    if(b->valid){
+      brelse(b);
+      continue;
+    }
+    acquire(&bk->lock);
+    b->ahead = 1;
+    bk->aheads++;
+    release(&bk->lock);
+    b->done = bdone;
+    bv[m++] = b;
+  }
+
+  // Started buffers belong to the disk until bdone().
+  started = iosubmit(bv, m, 0, 1);
+  for(i = started; i < m; i++){
+    b = bv[i];
+    bk = bhash(b->dev, b->blockno);
+    acquire(&bk->lock);
+    b->ahead = 0;
+    bk->aheads--;
+    release(&bk->lock);
+    b->done = 0;
+    brelse(b);
+  }
+}
+
 // Write b's contents to disk.  Must be locked.
 void
 bwrite(struct buf *b)
@@ -111,43 +443,93 @@ bwrite(struct buf *b)
   virtio_disk_rw(b, 1);
 }
 
+// Start writing the n locked buffers in bv to disk, all at
+// once, without waiting. n is at most NBATCH; bv may be
+// reordered. Call bwait() on each before using it again.
+void
+bstartwrite(struct buf **bv, int n)
+{
+  for(int i = 0; i < n; i++)
+    if(!holdingsleep(&bv[i]->lock))
+      panic("bstartwrite");
+  iosubmit(bv, n, 1, 0);
+}
+
+// Wait for a write started by bstartwrite() to finish.
+void
+bwait(struct buf *b)
+{
+  virtio_disk_wait(b);
+}
+
+// Write the n locked buffers in bv to disk, with all of the
+// writes in flight at once, and wait until they are done.
+// n is at most NBATCH; bv may be reordered.
+void
+bwritev(struct buf **bv, int n)
+{
+  bstartwrite(bv, n);
+  for(int i = 0; i < n; i++)
+    bwait(bv[i]);
+}
+
 // Release a locked buffer.
-// Move to the head of the most-recently-used list.
 void
 brelse(struct buf *b)
 {
+  struct bucket *bk;
+
   if(!holdingsleep(&b->lock))
     panic("brelse");
 
   releasesleep(&b->lock);
 
-  acquire(&bcache.lock);
+  bk = bhash(b->dev, b->blockno);
+  acquire(&bk->lock);
   b->refcnt--;
-  if (b->refcnt == 0) {
-    // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
-  }
-  
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
 void
 bpin(struct buf *b) {
-  acquire(&bcache.lock);
+  struct bucket *bk = bhash(b->dev, b->blockno);
+
+  acquire(&bk->lock);
   b->refcnt++;
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
 void
 bunpin(struct buf *b) {
-  acquire(&bcache.lock);
+  struct bucket *bk = bhash(b->dev, b->blockno);
+
+  acquire(&bk->lock);
   b->refcnt--;
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
+// Fill in cache size and hit/miss counters.
+void
+bcachestat(struct bcachestat *st)
+{
+  struct bucket *bk;
+  uint64 hits = 0, aheads = 0, aheadhits = 0;
 
+  for(bk = bcache.bucket; bk < bcache.bucket+NBUCKET; bk++){
+    acquire(&bk->lock);
+    hits += bk->hits;
+    aheads += bk->aheads;
+    aheadhits += bk->aheadhits;
+    release(&bk->lock);
+  }
+  st->hits = hits;
+  st->aheads = aheads;
+  st->aheadhits = aheadhits;
+  acquire(&bcache.lock);
+  st->nbuf = bcache.nbuf;
+  st->cold = bcache.nin;
+  st->misses = bcache.misses;
+  st->promotions = bcache.promotions;
+  st->recycled = bcache.recycled;
+  release(&bcache.lock);
+}
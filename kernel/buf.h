@@ -1,12 +1,17 @@
 struct buf {
   int valid;   // has data been read from disk?
   int disk;    // does disk "own" buf?
+  void (*done)(struct buf*); // if set, called when a transfer ends
+  struct buf *ionext; // next block in the same disk request
+  int ahead;   // read ahead, and not yet asked for
   uint dev;
   uint blockno;
   struct sleeplock lock;
   uint refcnt;
-  struct buf *prev; // LRU cache list
-  struct buf *next;
-  uchar data[BSIZE];
+  int hot;          // re-read after being recycled (2Q Am)
+  int ref;          // hit since the CLOCK hand last passed
+  struct buf *next; // hash bucket list
+  struct buf *clocknext; // ring of all buffers
+  uchar *data;      // BSIZE bytes
 };
 
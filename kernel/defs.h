@@ -1,7 +1,12 @@
+struct bcachestat;
 struct buf;
 struct context;
+struct dcachestat;
+struct diskstat;
 struct file;
 struct inode;
+struct kmem_cache;
+struct logstat;
 struct pipe;
 struct proc;
 struct spinlock;
@@ -12,10 +17,16 @@ struct superblock;
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
+void            breadahead(uint, uint*, int);
+struct buf*     bgetnew(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
+void            bwritev(struct buf**, int);
+void            bstartwrite(struct buf**, int);
+void            bwait(struct buf*);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
+void            bcachestat(struct bcachestat*);
 
 // console.c
 void            consoleinit(void);
@@ -24,6 +35,8 @@ void            consputc(int);
 
 // exec.c
 int             kexec(char*, char**);
+int             inexec(struct proc*, uint64, uint64);
+uint64          execfault(struct proc*, uint64);
 
 // file.c
 struct file*    filealloc(void);
@@ -38,8 +51,12 @@ int             filewrite(struct file*, uint64, int n);
 void            fsinit(int);
 int             dirlink(struct inode*, char*, uint);
 struct inode*   dirlookup(struct inode*, char*, uint*);
+void            dcacheenter(struct inode*, char*, uint, uint);
+void            dcachestat(struct dcachestat*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
+void            iexec(struct inode*, int);
+int             itextbusy(struct inode*);
 void            iinit();
 void            ilock(struct inode*);
 void            iput(struct inode*);
@@ -50,6 +67,7 @@ int             namecmp(const char*, const char*);
 struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, int, uint64, uint, uint);
+uint            readahead(struct inode*, uint, uint);
 void            stati(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
 void            itrunc(struct inode*);
@@ -57,6 +75,10 @@ void            ireclaim(int);
 
 // kalloc.c
 void*           kalloc(void);
+void*           kalloc_zeroed(void);
+int             kzero_idle(void);
+void*           superalloc(void);
+void            superfree(void*);
 void            kfree(void *);
 void            kinit(void);
 uint64          freemem(void);
@@ -67,8 +89,10 @@ void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
 void            begin_op(void);
 void            end_op(void);
+void            logstat(struct logstat*);
 
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
@@ -101,10 +125,22 @@ void            userinit(void);
 int             kwait(uint64);
 int             kwait2(uint64, uint64); //Lab04
 void            wakeup(void*);
+void            wakestat(uint64[3]);
 void            yield(void);
+void            preempt(void);
+void            rtpreempt(void);
+void            setnice(struct proc*, int);
+void            setsched(struct proc*, int);
+void            setrt(struct proc*, int, int);
+int             setaffinity(int, uint64);
+int             getaffinity(int);
+int             setquantum(int, int);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+int             procstat(uint64, int);
+int             runqstat(uint64, int);
+int             cansleep(void);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -117,6 +153,18 @@ void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
 
+// slab.c
+void            slabinit(void);
+void            kmem_cache_init(struct kmem_cache*, char*, uint);
+void*           kmem_cache_alloc(struct kmem_cache*);
+void            kmem_cache_free(struct kmem_cache*, void*);
+int             kmem_cache_stat(uint64, int);
+
+// schedtrace.c
+void            schedtraceinit(void);
+void            schedtrace(int, int, int);
+int             schedtracecopy(pagetable_t, uint64, int);
+
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
@@ -132,6 +180,11 @@ int             strlen(const char*);
 int             strncmp(const char*, const char*, uint);
 char*           strncpy(char*, const char*, int);
 
+// sysfile.c
+uint64          mmapfault(struct proc*, uint64);
+void            munmapall(struct proc*);
+int             mmapcopy(struct proc*, struct proc*);
+
 // syscall.c
 void            argint(int, int*);
 int             argstr(int, char*, int);
@@ -146,6 +199,9 @@ void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
 void            prepare_return(void);
+void            tickupdate(void);
+void            tickdeadline(uint);
+void            tickidle(void);
 
 // uart.c
 void            uartinit(void);
@@ -159,6 +215,7 @@ void            kvminit(void);
 void            kvminithart(void);
 void            kvmmap(pagetable_t, uint64, uint64, uint64, int);
 int             mappages(pagetable_t, uint64, uint64, uint64, int);
+int             mapsuper(pagetable_t, uint64, uint64, int);
 pagetable_t     uvmcreate(void);
 uint64          uvmalloc(pagetable_t, uint64, uint64, int);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
@@ -173,6 +230,7 @@ int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
 int             ismapped(pagetable_t, uint64);
 uint64          vmfault(pagetable_t, uint64, int);
+void            uvmprefault(struct proc*, uint64, uint64);
 
 // plic.c
 void            plicinit(void);
@@ -180,9 +238,15 @@ void            plicinithart(void);
 int             plic_claim(void);
 void            plic_complete(int);
 
+// iosched.c
+int             iosubmit(struct buf**, int, int, int);
+
 // virtio_disk.c
 void            virtio_disk_init(void);
 void            virtio_disk_rw(struct buf *, int);
+int             virtio_disk_submit(struct buf **, int, int, int);
+void            virtio_disk_wait(struct buf *);
+void            virtio_disk_stat(struct diskstat*);
 void            virtio_disk_intr(void);
 
 // number of elements in fixed-size array
@@ -6,8 +6,10 @@
 #include "proc.h"
 #include "defs.h"
 #include "elf.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "file.h"
 
-static int loadseg(pde_t *, uint64, struct inode *, uint, uint);
 
 // map ELF permissions to PTE permission bits.
 int flags2perm(int flags)
@@ -30,8 +32,10 @@ kexec(char *path, char **argv)
   int i, off;
   uint64 argc, sz = 0, sp, ustack[MAXARG], stackbase;
   struct elfhdr elf;
-  struct inode *ip;
+  struct inode *ip, *execip = 0, *oldexecip;
   struct proghdr ph;
+  struct execseg seg[NSEG];
+  int nseg = 0;
   pagetable_t pagetable = 0, oldpagetable;
   struct proc *p = myproc();
 
@@ -97,7 +101,8 @@ kexec(char *path, char **argv)
   if((pagetable = proc_pagetable(p)) == 0)
     goto bad;
 
-  // Load program into memory.
+  // Record the program's segments. Nothing is read yet:
+  // execfault() pages each one in from ip on first touch.
   for(i=0, off=elf.phoff; i<elf.phnum; i++, off+=sizeof(ph)){
     if(readi(ip, 0, (uint64)&ph, off, sizeof(ph)) != sizeof(ph))
       goto bad;
@@ -109,15 +114,23 @@ kexec(char *path, char **argv)
       goto bad;
     if(ph.vaddr % PGSIZE != 0)
       goto bad;
-    uint64 sz1;
-    if((sz1 = uvmalloc(pagetable, sz, ph.vaddr + ph.memsz, flags2perm(ph.flags))) == 0)
-      goto bad;
-    sz = sz1;
-    if(loadseg(pagetable, ph.vaddr, ip, ph.off, ph.filesz) < 0)
+    if(nseg >= NSEG)
       goto bad;
+    seg[nseg].va = ph.vaddr;
+    seg[nseg].memsz = ph.memsz;
+    seg[nseg].filesz = ph.filesz;
+    seg[nseg].off = ph.off;
+    seg[nseg].perm = PTE_R | PTE_U | flags2perm(ph.flags);
+    nseg++;
+    if(ph.vaddr + ph.memsz > sz)
+      sz = ph.vaddr + ph.memsz;
   }
-  iunlockput(ip);
+  // keep a reference to ip for as long as the image exists,
+  // and keep writers out of it meanwhile.
+  iexec(ip, 1);
+  iunlock(ip);
   end_op();
+  execip = ip;
   ip = 0;
 
   p = myproc();
@@ -128,10 +141,6 @@ kexec(char *path, char **argv)
   // Use the rest as the user stack.
   sz = PGROUNDUP(sz);
 
-  //lab09
-  p->mmap = TRAPFRAME - PGSIZE;
-  p->has_mmap = 0;
-  
   uint64 sz1;
   if((sz1 = uvmalloc(pagetable, sz, sz + (USERSTACK+1)*PGSIZE, PTE_W)) == 0)
     goto bad;
@@ -175,12 +184,28 @@ kexec(char *path, char **argv)
   safestrcpy(p->name, last, sizeof(p->name));
     
   // Commit to the user image.
+  munmapall(p);
   oldpagetable = p->pagetable;
+  oldexecip = p->execip;
   p->pagetable = pagetable;
   p->sz = sz;
+  p->execip = execip;
+  memmove(p->seg, seg, sizeof(seg));
+  p->nseg = nseg;
   p->trapframe->epc = elf.entry;  // initial program counter = main
   p->trapframe->sp = sp; // initial stack pointer
   proc_freepagetable(oldpagetable, oldsz);
+  if(oldexecip){
+    iexec(oldexecip, -1);
+    begin_op();
+    iput(oldexecip);
+    end_op();
+  }
+
+  // Page in the entry point now rather than by the first
+  // instruction fetch; a failure here only leaves the page to
+  // be faulted in later.
+  execfault(p, elf.entry);
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
 
@@ -191,30 +216,75 @@ kexec(char *path, char **argv)
     iunlockput(ip);
     end_op();
   }
+  if(execip){
+    iexec(execip, -1);
+    begin_op();
+    iput(execip);
+    end_op();
+  }
   return -1;
 }
 
-// Load an ELF program segment into pagetable at virtual address va.
-// va must be page-aligned
-// and the pages from va to va+sz must already be mapped.
-// Returns 0 on success, -1 on failure.
-static int
-loadseg(pagetable_t pagetable, uint64 va, struct inode *ip, uint offset, uint sz)
+// Does [va, va+len) overlap one of p's program segments?
+int
+inexec(struct proc *p, uint64 va, uint64 len)
 {
-  uint i, n;
-  uint64 pa;
-
-  for(i = 0; i < sz; i += PGSIZE){
-    pa = walkaddr(pagetable, va + i);
-    if(pa == 0)
-      panic("loadseg: address should exist");
-    if(sz - i < PGSIZE)
-      n = sz - i;
-    else
-      n = PGSIZE;
-    if(readi(ip, 0, (uint64)pa, offset+i, n) != n)
-      return -1;
+  for(int i = 0; i < p->nseg; i++){
+    struct execseg *s = &p->seg[i];
+    if(va < s->va + s->memsz && va + len > s->va)
+      return 1;
   }
-  
   return 0;
 }
+
+// Page in the page at va, which inexec() says belongs to a
+// program segment: read the part backed by the file, zero the
+// rest, and map it with the segment's permissions.
+// Returns the physical address, or 0 on failure.
+uint64
+execfault(struct proc *p, uint64 va)
+{
+  struct execseg *s = 0;
+  uint64 mem, start, end;
+  int locked;
+
+  // segments start page-aligned, so one page is in only one.
+  va = PGROUNDDOWN(va);
+  for(int i = 0; i < p->nseg; i++){
+    if(va < p->seg[i].va + p->seg[i].memsz && va + PGSIZE > p->seg[i].va){
+      s = &p->seg[i];
+      break;
+    }
+  }
+  if(s == 0)
+    return 0;
+
+  // only pages overlapping the file contents need the disk.
+  start = va < s->va ? s->va : va;
+  end = va + PGSIZE;
+  if(end > s->va + s->filesz)
+    end = s->va + s->filesz;
+  if(start < end && !cansleep())
+    return 0;
+
+  if((mem = (uint64)kalloc_zeroed()) == 0)
+    return 0;
+  if(start < end){
+    // read(fd, buf, n) on our own executable already holds the lock.
+    locked = holdingsleep(&p->execip->lock);
+    if(!locked)
+      ilock(p->execip);
+    int n = readi(p->execip, 0, mem + (start - va), s->off + (start - s->va), end - start);
+    if(!locked)
+      iunlock(p->execip);
+    if(n != end - start){
+      kfree((void*)mem);
+      return 0;
+    }
+  }
+  if(mappages(p->pagetable, va, PGSIZE, mem, s->perm) != 0){
+    kfree((void*)mem);
+    return 0;
+  }
+  return mem;
+}
@@ -13,6 +13,11 @@
 #include "stat.h"
 #include "proc.h"
 
+#define RAMIN 2   // read-ahead window, in blocks, once a read is sequential
+#ifndef RAMAX
+#define RAMAX 16  // largest read-ahead window; build with RAMAX=n to change
+#endif
+
 struct devsw devsw[NDEV];
 struct {
   struct spinlock lock;
@@ -101,6 +106,33 @@ filestat(struct file *f, uint64 addr)
   return -1;
 }
 
+// n bytes of f were just read at f->off. If the read began
+// where the last one ended, grow the read-ahead window (up to
+// RAMAX blocks) and start reading the blocks that fall in it
+// but have not been asked for yet; any other read is a seek,
+// and closes the window. Caller must hold f->ip->lock.
+static void
+seqread(struct file *f, uint n)
+{
+  uint next = (f->off + n) / BSIZE;
+
+  if(f->off / BSIZE != f->ranext){
+    f->rawin = 0;
+    f->raend = 0;
+  } else if(f->rawin == 0){
+    f->rawin = RAMIN < RAMAX ? RAMIN : RAMAX;
+  } else if(f->rawin < RAMAX){
+    f->rawin = 2 * f->rawin < RAMAX ? 2 * f->rawin : RAMAX;
+  }
+  f->ranext = next;
+  if(f->rawin == 0)
+    return;
+  if(f->raend < next)
+    f->raend = next;
+  if(f->raend < next + f->rawin)
+    f->raend = readahead(f->ip, f->raend, next + f->rawin - f->raend);
+}
+
 // Read from file f.
 // addr is a user virtual address.
 int
@@ -111,6 +143,10 @@ fileread(struct file *f, uint64 addr, int n)
   if(f->readable == 0)
     return -1;
 
+  // page in file-backed parts of the buffer first, so that no
+  // read faults one in while holding a lock (readi() holds a
+  // block's buffer while it copies).
+  uvmprefault(myproc(), addr, n);
   if(f->type == FD_PIPE){
     r = piperead(f->pipe, addr, n);
   } else if(f->type == FD_DEVICE){
@@ -119,8 +155,10 @@ fileread(struct file *f, uint64 addr, int n)
     r = devsw[f->major].read(1, addr, n);
   } else if(f->type == FD_INODE){
     ilock(f->ip);
-    if((r = readi(f->ip, 1, addr, f->off, n)) > 0)
+    if((r = readi(f->ip, 1, addr, f->off, n)) > 0){
+      seqread(f, r);
       f->off += r;
+    }
     iunlock(f->ip);
   } else {
     panic("fileread");
@@ -139,6 +177,8 @@ filewrite(struct file *f, uint64 addr, int n)
   if(f->writable == 0)
     return -1;
 
+  // as in fileread().
+  uvmprefault(myproc(), addr, n);
   if(f->type == FD_PIPE){
     ret = pipewrite(f->pipe, addr, n);
   } else if(f->type == FD_DEVICE){
@@ -159,7 +199,9 @@ filewrite(struct file *f, uint64 addr, int n)
 
       begin_op();
       ilock(f->ip);
-      if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
+      if(itextbusy(f->ip))
+        r = -1;  // a running program
+      else if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
         f->off += r;
       iunlock(f->ip);
       end_op();
@@ -20,12 +20,17 @@
 #include "fs.h"
 #include "buf.h"
 #include "file.h"
+#include "iostat.h"
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 // there should be one superblock per disk device, but we run with
 // only one device
 struct superblock sb; 
 
+static void bsuminit(int);
+static void dcacheinit(void);
+static void dcachepurge(struct inode*);
+
 // Read the super block.
 static void
 readsb(int dev, struct superblock *sb)
@@ -44,16 +49,17 @@ fsinit(int dev) {
   if(sb.magic != FSMAGIC)
     panic("invalid file system");
   initlog(dev, &sb);
+  bsuminit(dev);
   ireclaim(dev);
 }
 
-// Zero a block.
+// Zero a block. There is no need to read it first.
 static void
 bzero(int dev, int bno)
 {
   struct buf *bp;
 
-  bp = bread(dev, bno);
+  bp = bgetnew(dev, bno);
   memset(bp->data, 0, BSIZE);
   log_write(bp);
   brelse(bp);
@@ -61,29 +67,120 @@ bzero(int dev, int bno)
 
 // Blocks.
 
-// Allocate a zeroed disk block.
-// returns 0 if out of disk space.
-static uint
-balloc(uint dev)
+// Where the search for a free block starts when the caller
+// has no better idea: just after the last block allocated,
+// so that new files are laid out one after another. Only a
+// hint, so updates may race.
+static uint ballocnext;
+
+// In-memory summary of the free bitmap, so that balloc()
+// need not read bitmap blocks that have nothing free, nor
+// scan the used blocks at the start of each one. Entry k is
+// for bitmap block k, and only changes while that block's
+// buffer is locked; balloc() reads the counts without it,
+// as a hint.
+#define NBMAP (FSSIZE/BPB + 1)
+static struct {
+  uint nfree[NBMAP];   // free blocks in the block
+  uint first[NBMAP];   // every bit below this one is in use
+} bsum;
+
+// Count the free blocks in each bitmap block.
+static void
+bsuminit(int dev)
 {
-  int b, bi, m;
   struct buf *bp;
+  uint b, bi;
 
-  bp = 0;
+  if(sb.size > NBMAP*BPB)
+    panic("bsuminit: file system too big");
   for(b = 0; b < sb.size; b += BPB){
     bp = bread(dev, BBLOCK(b, sb));
+    bsum.first[b/BPB] = BPB;
     for(bi = 0; bi < BPB && b + bi < sb.size; bi++){
-      m = 1 << (bi % 8);
-      if((bp->data[bi/8] & m) == 0){  // Is block free?
-        bp->data[bi/8] |= m;  // Mark block in use.
-        log_write(bp);
-        brelse(bp);
-        bzero(dev, b + bi);
-        return b + bi;
+      if((bp->data[bi/8] & (1 << (bi % 8))) == 0){
+        if(bsum.nfree[b/BPB]++ == 0)
+          bsum.first[b/BPB] = bi;
       }
     }
     brelse(bp);
   }
+}
+
+// Allocate a zeroed disk block after block prev, so that a
+// file's blocks follow one another on disk. A prev of 0
+// means anywhere. The block right after prev is best. If it
+// is taken, perhaps by another file growing at the same
+// time, take the first block of a run of eight free ones
+// (a free byte in the bitmap), where the file has room to
+// grow, or else the first free block, from the same bitmap
+// block. Bitmap blocks with nothing free are not read, and
+// used blocks are skipped a word at a time.
+// returns 0 if out of disk space.
+static uint
+balloc(uint dev, uint prev)
+{
+  uint b, bi, k, end, n, first, found, alt;
+  uint64 *w;
+  struct buf *bp;
+
+  first = prev ? prev + 1 : ballocnext;
+  if(first >= sb.size)
+    first = 0;
+  b = first;
+  for(n = 0; n < sb.size; ){
+    k = b / BPB;
+    end = b - b % BPB + BPB;
+    if(end > sb.size)
+      end = sb.size;
+    if(bsum.nfree[k] == 0){
+      n += end - b;
+      b = end < sb.size ? end : 0;
+      continue;
+    }
+    if(b % BPB < bsum.first[k]){
+      n += bsum.first[k] - b % BPB;
+      b = b - b % BPB + bsum.first[k];
+    }
+
+    bp = bread(dev, BBLOCK(b, sb));
+    w = (uint64*)bp->data;
+    // block 0, the boot block, is never free.
+    found = alt = 0;
+    for(; b < end && n < sb.size; b++, n++){
+      bi = b % BPB;
+      if(bi % 64 == 0 && b + 64 <= end && w[bi/64] == ~0UL){
+        b += 63;  // all 64 in use
+        n += 63;
+        continue;
+      }
+      if(bp->data[bi/8] & (1 << (bi % 8)))
+        continue;
+      if(b == first || (bi % 8 == 0 && b + 8 <= end && bp->data[bi/8] == 0)){
+        found = b;
+        break;
+      }
+      if(alt == 0)
+        alt = b;
+    }
+    if(found == 0)
+      found = alt;
+    if(found){
+      bi = found % BPB;
+      bp->data[bi/8] |= 1 << (bi % 8);  // Mark block in use.
+      log_write(bp);
+      bsum.nfree[k]--;
+      if(bi == bsum.first[k])
+        bsum.first[k]++;
+      brelse(bp);
+      bzero(dev, found);
+      ballocnext = found + 1;
+      return found;
+    }
+    brelse(bp);
+    if(b >= sb.size)
+      b = 0;
+  }
   printf("balloc: out of blocks\n");
   return 0;
 }
@@ -102,6 +199,9 @@ bfree(int dev, uint b)
     panic("freeing free block");
   bp->data[bi/8] &= ~m;
   log_write(bp);
+  bsum.nfree[b/BPB]++;
+  if(bi < bsum.first[b/BPB])
+    bsum.first[b/BPB] = bi;
   brelse(bp);
 }
 
@@ -188,6 +288,7 @@ iinit()
   for(i = 0; i < NINODE; i++) {
     initsleeplock(&itable.inode[i].lock, "inode");
   }
+  dcacheinit();
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -288,6 +389,32 @@ idup(struct inode *ip)
   return ip;
 }
 
+// Count a process that starts (delta 1) or stops (-1)
+// running the program in ip. exec pages the program's text
+// in from ip on demand (see execfault()), so while any
+// process runs it, writes to ip are refused (see itextbusy()).
+void
+iexec(struct inode *ip, int delta)
+{
+  acquire(&itable.lock);
+  ip->nexec += delta;
+  release(&itable.lock);
+}
+
+// Is some process running the program in ip? Callers about
+// to change its contents hold ip->lock, which exec also holds
+// when it starts counting, so the answer cannot go stale.
+int
+itextbusy(struct inode *ip)
+{
+  int busy;
+
+  acquire(&itable.lock);
+  busy = ip->nexec > 0;
+  release(&itable.lock);
+  return busy;
+}
+
 // Lock the given inode.
 // Reads the inode from disk if necessary.
 void
@@ -349,6 +476,8 @@ iput(struct inode *ip)
     release(&itable.lock);
 
     itrunc(ip);
+    if(ip->type == T_DIR)
+      dcachepurge(ip);
     ip->type = 0;
     iupdate(ip);
     ip->valid = 0;
@@ -397,7 +526,9 @@ ireclaim(int dev)
 // The content (data) associated with each inode is stored
 // in blocks on the disk. The first NDIRECT block numbers
 // are listed in ip->addrs[].  The next NINDIRECT blocks are
-// listed in block ip->addrs[NDIRECT].
+// listed in block ip->addrs[NDIRECT]. The last NDINDIRECT
+// are listed in the NINDIRECT blocks that are listed in
+// block ip->addrs[NDIRECT+1].
 
 // Return the disk block address of the nth block in inode ip.
 // If there is no such block, bmap allocates one.
@@ -405,12 +536,14 @@ ireclaim(int dev)
 static uint
 bmap(struct inode *ip, uint bn)
 {
-  uint addr, *a;
+  uint addr, ind, i, *a;
   struct buf *bp;
 
+  // New blocks go right after the file's previous block,
+  // if that is free (see balloc()).
   if(bn < NDIRECT){
     if((addr = ip->addrs[bn]) == 0){
-      addr = balloc(ip->dev);
+      addr = balloc(ip->dev, bn > 0 ? ip->addrs[bn-1] : 0);
       if(addr == 0)
         return 0;
       ip->addrs[bn] = addr;
@@ -422,7 +555,7 @@ bmap(struct inode *ip, uint bn)
   if(bn < NINDIRECT){
     // Load indirect block, allocating if necessary.
     if((addr = ip->addrs[NDIRECT]) == 0){
-      addr = balloc(ip->dev);
+      addr = balloc(ip->dev, ip->addrs[NDIRECT-1]);
       if(addr == 0)
         return 0;
       ip->addrs[NDIRECT] = addr;
@@ -430,7 +563,7 @@ bmap(struct inode *ip, uint bn)
     bp = bread(ip->dev, addr);
     a = (uint*)bp->data;
     if((addr = a[bn]) == 0){
-      addr = balloc(ip->dev);
+      addr = balloc(ip->dev, bn > 0 ? a[bn-1] : ip->addrs[NDIRECT]);
       if(addr){
         a[bn] = addr;
         log_write(bp);
@@ -439,6 +572,44 @@ bmap(struct inode *ip, uint bn)
     brelse(bp);
     return addr;
   }
+  bn -= NINDIRECT;
+
+  if(bn < NDINDIRECT){
+    // Load double-indirect block, allocating if necessary.
+    if((addr = ip->addrs[NDIRECT+1]) == 0){
+      addr = balloc(ip->dev, ip->addrs[NDIRECT]);
+      if(addr == 0)
+        return 0;
+      ip->addrs[NDIRECT+1] = addr;
+    }
+    // Then the indirect block it lists for bn.
+    bp = bread(ip->dev, addr);
+    a = (uint*)bp->data;
+    i = bn / NINDIRECT;
+    if((addr = a[i]) == 0){
+      addr = balloc(ip->dev, i > 0 ? a[i-1] : ip->addrs[NDIRECT+1]);
+      if(addr){
+        a[i] = addr;
+        log_write(bp);
+      }
+    }
+    brelse(bp);
+    if(addr == 0)
+      return 0;
+    ind = addr;
+    bp = bread(ip->dev, ind);
+    a = (uint*)bp->data;
+    i = bn % NINDIRECT;
+    if((addr = a[i]) == 0){
+      addr = balloc(ip->dev, i > 0 ? a[i-1] : ind);
+      if(addr){
+        a[i] = addr;
+        log_write(bp);
+      }
+    }
+    brelse(bp);
+    return addr;
+  }
 
   panic("bmap: out of range");
 }
@@ -449,8 +620,8 @@ void
 itrunc(struct inode *ip)
 {
   int i, j;
-  struct buf *bp;
-  uint *a;
+  struct buf *bp, *bp2;
+  uint *a, *a2;
 
   for(i = 0; i < NDIRECT; i++){
     if(ip->addrs[i]){
@@ -471,6 +642,26 @@ itrunc(struct inode *ip)
     ip->addrs[NDIRECT] = 0;
   }
 
+  if(ip->addrs[NDIRECT+1]){
+    bp = bread(ip->dev, ip->addrs[NDIRECT+1]);
+    a = (uint*)bp->data;
+    for(i = 0; i < NINDIRECT; i++){
+      if(a[i] == 0)
+        continue;
+      bp2 = bread(ip->dev, a[i]);
+      a2 = (uint*)bp2->data;
+      for(j = 0; j < NINDIRECT; j++){
+        if(a2[j])
+          bfree(ip->dev, a2[j]);
+      }
+      brelse(bp2);
+      bfree(ip->dev, a[i]);
+    }
+    brelse(bp);
+    bfree(ip->dev, ip->addrs[NDIRECT+1]);
+    ip->addrs[NDIRECT+1] = 0;
+  }
+
   ip->size = 0;
   iupdate(ip);
 }
@@ -518,6 +709,30 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
   return tot;
 }
 
+// Start reading n blocks of ip from block bn into the buffer
+// cache, without waiting for them. Stops at the end of the
+// file, and returns the block after the last one started.
+// Caller must hold ip->lock.
+uint
+readahead(struct inode *ip, uint bn, uint n)
+{
+  uint nb = (ip->size + BSIZE - 1) / BSIZE;
+  uint addrs[NBATCH];
+  int k = 0;
+
+  for(; n > 0 && bn < nb; n--, bn++){
+    if((addrs[k] = bmap(ip, bn)) == 0)
+      break;
+    if(++k == NBATCH){
+      breadahead(ip->dev, addrs, k);
+      k = 0;
+    }
+  }
+  if(k > 0)
+    breadahead(ip->dev, addrs, k);
+  return bn;
+}
+
 // Write data to inode.
 // Caller must hold ip->lock.
 // If user_src==1, then src is a user virtual address;
@@ -569,8 +784,117 @@ namecmp(const char *s, const char *t)
   return strncmp(s, t, DIRSIZ);
 }
 
+// Directory entry cache.
+//
+// Remembers the results of dirlookup(), including names
+// that are not there, so that resolving the same paths over
+// and over (as a shell script running commands does) need
+// not scan the directories each time. The table is direct
+// mapped: a new entry replaces whatever hashed to its slot.
+//
+// The entries for a directory only change while it is
+// locked: dirlookup() and dirlink() keep them up to date,
+// sys_unlink() calls dcacheenter() when it removes a name,
+// and iput() drops them when it frees the directory.
+
+struct dentry {
+  uint dev;
+  uint dir;            // directory's inode number; 0 if unused
+  char name[DIRSIZ];
+  uint inum;           // 0 if name is not in the directory
+  uint off;            // offset of the directory entry
+};
+
+struct {
+  struct spinlock lock;
+  struct dentry entry[NDCACHE];
+  uint64 hits, misses;
+} dcache;
+
+static void
+dcacheinit(void)
+{
+  initlock(&dcache.lock, "dcache");
+}
+
+static struct dentry*
+dhash(uint dev, uint dir, char *name)
+{
+  uint h = dev * 31 + dir;
+
+  for(int i = 0; i < DIRSIZ && name[i]; i++)
+    h = h * 31 + (uchar)name[i];
+  return &dcache.entry[h % NDCACHE];
+}
+
+// Look name up in directory dp's cached entries. Returns 1
+// and sets *pinum (0 if name is absent) and *poff if found.
+// Caller must hold dp->lock.
+static int
+dcachelookup(struct inode *dp, char *name, uint *pinum, uint *poff)
+{
+  struct dentry *d;
+  int found = 0;
+
+  acquire(&dcache.lock);
+  d = dhash(dp->dev, dp->inum, name);
+  if(d->dir == dp->inum && d->dev == dp->dev && namecmp(d->name, name) == 0){
+    *pinum = d->inum;
+    *poff = d->off;
+    found = 1;
+    dcache.hits++;
+  } else {
+    dcache.misses++;
+  }
+  release(&dcache.lock);
+  return found;
+}
+
+// Record that name in directory dp is inode inum, in the
+// entry at offset off, or with inum 0 that it is absent.
+// Caller must hold dp->lock.
+void
+dcacheenter(struct inode *dp, char *name, uint inum, uint off)
+{
+  struct dentry *d;
+
+  acquire(&dcache.lock);
+  d = dhash(dp->dev, dp->inum, name);
+  d->dev = dp->dev;
+  d->dir = dp->inum;
+  strncpy(d->name, name, DIRSIZ);
+  d->inum = inum;
+  d->off = off;
+  release(&dcache.lock);
+}
+
+// Forget every entry for directory dp, which is being freed.
+static void
+dcachepurge(struct inode *dp)
+{
+  struct dentry *d;
+
+  acquire(&dcache.lock);
+  for(d = dcache.entry; d < dcache.entry+NDCACHE; d++)
+    if(d->dir == dp->inum && d->dev == dp->dev)
+      d->dir = 0;
+  release(&dcache.lock);
+}
+
+// Fill in the directory entry cache's hit and miss counts.
+void
+dcachestat(struct dcachestat *st)
+{
+  acquire(&dcache.lock);
+  st->nentry = NDCACHE;
+  st->hits = dcache.hits;
+  st->misses = dcache.misses;
+  release(&dcache.lock);
+}
+
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
+// Caller must hold dp->lock.
 struct inode*
 dirlookup(struct inode *dp, char *name, uint *poff)
 {
@@ -580,6 +904,14 @@ dirlookup(struct inode *dp, char *name, uint *poff)
   if(dp->type != T_DIR)
     panic("dirlookup not DIR");
 
+  if(dcachelookup(dp, name, &inum, &off)){
+    if(inum == 0)
+      return 0;
+    if(poff)
+      *poff = off;
+    return iget(dp->dev, inum);
+  }
+
   for(off = 0; off < dp->size; off += sizeof(de)){
     if(readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
       panic("dirlookup read");
@@ -590,10 +922,12 @@ dirlookup(struct inode *dp, char *name, uint *poff)
       if(poff)
         *poff = off;
       inum = de.inum;
+      dcacheenter(dp, name, inum, off);
       return iget(dp->dev, inum);
     }
   }
 
+  dcacheenter(dp, name, 0, 0);
   return 0;
 }
 
@@ -624,6 +958,7 @@ dirlink(struct inode *dp, char *name, uint inum)
   de.inum = inum;
   if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
     return -1;
+  dcacheenter(dp, name, inum, off);
 
   return 0;
 }
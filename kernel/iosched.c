@@ -0,0 +1,82 @@
+// Block I/O scheduling, between the buffer cache and the
+// disk driver.
+//
+// The buffer cache hands batches of buffers to iosubmit()
+// (see bwritev() and breadahead() in bio.c). Each batch is
+// put in elevator order: one sweep up from the block after
+// the last request, then around to the lowest block (C-SCAN).
+// Runs of consecutive blocks are merged into one virtio
+// request each, with a descriptor per block, so that a log
+// commit, whose blocks are consecutive, costs a few disk
+// round trips rather than one per block.
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "fs.h"
+#include "buf.h"
+
+#define NMERGE NBATCH  // most blocks merged into one request
+
+// Where the last batch left the disk head. Only a hint for
+// the next sweep, so updates may race.
+static uint lastblock;
+
+// Sort the n bufs in bv by block number, counting from
+// block from and wrapping around: the unsigned difference
+// puts the blocks below from after all the others. n is at
+// most NBATCH, so insertion sort does.
+static void
+elevator(struct buf **bv, int n, uint from)
+{
+  struct buf *b;
+  int i, j;
+
+  for(i = 1; i < n; i++){
+    b = bv[i];
+    for(j = i; j > 0 && bv[j-1]->blockno - from > b->blockno - from; j--)
+      bv[j] = bv[j-1];
+    bv[j] = b;
+  }
+}
+
+// Start reading (or writing) the n locked bufs in bv, in as
+// few disk requests as possible, and return without waiting
+// (see virtio_disk_submit()). Leaves bv in the order the
+// requests were made; returns how many bufs, from the start
+// of bv, were started, which is less than n only if nowait
+// is set and the disk ran out of descriptors.
+int
+iosubmit(struct buf **bv, int n, int write, int nowait)
+{
+  struct buf *reqs[NBATCH];
+  int len[NBATCH];
+  int i, j, nreq, started, nb;
+
+  if(n > NBATCH)
+    panic("iosubmit");
+  elevator(bv, n, lastblock);
+
+  nreq = 0;
+  for(i = 0; i < n; i = j){
+    for(j = i + 1; j < n && j - i < NMERGE; j++){
+      if(bv[j]->dev != bv[i]->dev || bv[j]->blockno != bv[j-1]->blockno + 1)
+        break;
+      bv[j-1]->ionext = bv[j];
+    }
+    bv[j-1]->ionext = 0;
+    reqs[nreq] = bv[i];
+    len[nreq++] = j - i;
+  }
+  if(n > 0)
+    lastblock = bv[n-1]->blockno + 1;
+
+  // bufs of started requests may already be done and gone.
+  started = virtio_disk_submit(reqs, nreq, write, nowait);
+  for(nb = 0, i = 0; i < started; i++)
+    nb += len[i];
+  return nb;
+}
@@ -0,0 +1,43 @@
+// Buffer cache, disk, log and name cache counters, as
+// returned by bcachestat(). Each part is filled in by the
+// subsystem it describes.
+
+struct bcachestat {
+  int nbuf;           // buffers
+  int cold;           // of them cold (2Q's A1in)
+  uint64 hits;
+  uint64 misses;
+  uint64 promotions;  // misses found in the ghost list
+  uint64 recycled;    // buffers given to another block
+  uint64 aheads;      // reads started by breadahead()
+  uint64 aheadhits;   // ... whose block was then asked for
+};
+
+struct diskstat {
+  uint64 nread;       // read requests
+  uint64 nwrite;      // write requests
+  uint64 nblocks;     // blocks moved by them
+  int inflight;       // requests at the disk now
+  int maxinflight;    // most ever at once
+};
+
+struct logstat {
+  int size;           // log blocks
+  int used;           // in the current transaction
+  uint64 ncommit;
+  uint64 ncheckpoint;
+  uint64 nabsorbed;   // writes to a block already logged
+};
+
+struct dcachestat {
+  int nentry;
+  uint64 hits;
+  uint64 misses;
+};
+
+struct iostat {
+  struct bcachestat bcache;
+  struct diskstat disk;
+  struct logstat log;
+  struct dcachestat dcache;
+};
@@ -21,11 +21,27 @@ struct run {
   struct run *next;
 };
 
+// Idle harts zero free pages ahead of time into the zeroed
+// list (see kzero_idle), so kalloc_zeroed() callers such as
+// page faults usually skip the memset.
+#define NZEROED 256  // max pages kept pre-zeroed
+
 struct {
   struct spinlock lock;
   struct run *freelist;
+  struct run *zeroed;  // free pages already filled with zeros
+  int nzeroed;
+  struct run *superlist; // free 2MB-aligned megapages
+  int nsuper;
+  // free 4KB pages of broken-up megapages, kept per megapage
+  // so that one whose pages all come back is whole again.
+  struct run *sub[NSUPERPG];
+  int nsub[NSUPERPG];
+  int nsubfree;          // total over nsub[]
 } kmem;
 
+static char *superbase;  // first megapage; the reserve ends at PHYSTOP
+
 /* Convert physical address to index in reference count array */
 static inline int
 pa2idx(uint64 pa)
@@ -33,6 +49,15 @@ pa2idx(uint64 pa)
   return (pa - KERNBASE) / PGSIZE;
 }
 
+// Index of the reserved megapage holding pa, or -1.
+static inline int
+superidx(uint64 pa)
+{
+  if(pa < (uint64)superbase || pa >= PHYSTOP)
+    return -1;
+  return (pa - (uint64)superbase) / SUPERPGSIZE;
+}
+
 void
 kinit()
 {
@@ -42,7 +67,16 @@ kinit()
     ref_count[i] = 0;
   }
   
-  freerange(end, (void*)PHYSTOP);
+  // Set aside the top NSUPERPG*2MB of RAM, which is 2MB-aligned,
+  // as megapages for superalloc(). Everything below is 4KB pages.
+  superbase = (char*)(PHYSTOP - NSUPERPG*SUPERPGSIZE);
+  freerange(end, superbase);
+  for(char *p = superbase; p < (char*)PHYSTOP; p += SUPERPGSIZE){
+    struct run *r = (struct run*)p;
+    r->next = kmem.superlist;
+    kmem.superlist = r;
+    kmem.nsuper++;
+  }
 }
 
 void
@@ -80,12 +114,54 @@ kfree(void *pa)
 
   r = (struct run*)pa;
 
+  int m = superidx((uint64)pa);
+  if(m >= 0){
+    // a page of a broken-up megapage.
+    r->next = kmem.sub[m];
+    kmem.sub[m] = r;
+    kmem.nsub[m]++;
+    kmem.nsubfree++;
+    if(kmem.nsub[m] == SUPERPGSIZE / PGSIZE){
+      // all of its pages are back; whole again.
+      kmem.sub[m] = 0;
+      kmem.nsub[m] = 0;
+      kmem.nsubfree -= SUPERPGSIZE / PGSIZE;
+      r = (struct run*)(superbase + (uint64)m * SUPERPGSIZE);
+      r->next = kmem.superlist;
+      kmem.superlist = r;
+      kmem.nsuper++;
+    }
+    release(&kmem.lock);
+    return;
+  }
+
  // acquire(&kmem.lock);
   r->next = kmem.freelist;
   kmem.freelist = r;
   release(&kmem.lock);
 }
 
+// Take a page from the broken-up megapage with the fewest
+// free pages, leaving the others the best chance to become
+// whole again. Caller must hold kmem.lock.
+static struct run*
+subtake(void)
+{
+  struct run *r;
+  int best = -1;
+
+  for(int m = 0; m < NSUPERPG; m++)
+    if(kmem.nsub[m] > 0 && (best < 0 || kmem.nsub[m] < kmem.nsub[best]))
+      best = m;
+  if(best < 0)
+    return 0;
+  r = kmem.sub[best];
+  kmem.sub[best] = r->next;
+  kmem.nsub[best]--;
+  kmem.nsubfree--;
+  return r;
+}
+
 // Allocate one 4096-byte page of physical memory.
 // Returns a pointer that the kernel can use.
 // Returns 0 if the memory cannot be allocated.
@@ -98,6 +174,24 @@ kalloc(void)
   r = kmem.freelist;
   if(r)
     kmem.freelist = r->next;
+  else if((r = kmem.zeroed) != 0){
+    kmem.zeroed = r->next;
+    kmem.nzeroed--;
+  } else if((r = subtake()) != 0){
+    // a page of a megapage that is already broken up.
+  } else if((r = kmem.superlist) != 0){
+    // out of small pages; break up a megapage. Its pages
+    // return to it as they are freed (see kfree()).
+    int m = superidx((uint64)r);
+    kmem.superlist = r->next;
+    kmem.nsuper--;
+    for(char *p = (char*)r + PGSIZE; p < (char*)r + SUPERPGSIZE; p += PGSIZE){
+      ((struct run*)p)->next = kmem.sub[m];
+      kmem.sub[m] = (struct run*)p;
+    }
+    kmem.nsub[m] = SUPERPGSIZE / PGSIZE - 1;
+    kmem.nsubfree += SUPERPGSIZE / PGSIZE - 1;
+  }
   release(&kmem.lock);
 
   if(r) {
@@ -112,6 +206,103 @@ kalloc(void)
   return (void*)r;
 }
 
+// Allocate one zero-filled page, preferring pages that an
+// idle hart has already zeroed.
+// Returns 0 if the memory cannot be allocated.
+void *
+kalloc_zeroed(void)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  r = kmem.zeroed;
+  if(r){
+    kmem.zeroed = r->next;
+    kmem.nzeroed--;
+    ref_count[pa2idx((uint64)r)] = 1;
+  }
+  release(&kmem.lock);
+
+  if(r){
+    r->next = 0;  // the only non-zero word of a zeroed page
+    return (void*)r;
+  }
+
+  if((r = kalloc()) != 0)
+    memset((char*)r, 0, PGSIZE);
+  return (void*)r;
+}
+
+// Allocate one 2MB-aligned megapage. Not zeroed.
+// Returns 0 if none is left.
+void *
+superalloc(void)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  r = kmem.superlist;
+  if(r){
+    kmem.superlist = r->next;
+    kmem.nsuper--;
+    // every 4KB page has its own count, so that a
+    // demoted megapage can be freed a page at a time.
+    for(int i = 0; i < SUPERPGSIZE / PGSIZE; i++)
+      ref_count[pa2idx((uint64)r) + i] = 1;
+  }
+  release(&kmem.lock);
+
+  return (void*)r;
+}
+
+// Free a megapage returned by superalloc() that is
+// still mapped as a whole.
+void
+superfree(void *pa)
+{
+  struct run *r;
+
+  if(((uint64)pa % SUPERPGSIZE) != 0)
+    panic("superfree");
+
+  acquire(&kmem.lock);
+  for(int i = 0; i < SUPERPGSIZE / PGSIZE; i++)
+    ref_count[pa2idx((uint64)pa) + i] = 0;
+  r = (struct run*)pa;
+  r->next = kmem.superlist;
+  kmem.superlist = r;
+  kmem.nsuper++;
+  release(&kmem.lock);
+}
+
+// Called by scheduler() when it finds nothing to run.
+// Moves one page from the free list to the zeroed list.
+// Returns 0 if there was nothing to do, so the hart can
+// go to sleep instead.
+int
+kzero_idle(void)
+{
+  struct run *r;
+
+  acquire(&kmem.lock);
+  if(kmem.nzeroed >= NZEROED || (r = kmem.freelist) == 0){
+    release(&kmem.lock);
+    return 0;
+  }
+  kmem.freelist = r->next;
+  release(&kmem.lock);
+
+  // the page is off both lists, so no lock is needed to zero it.
+  memset((char*)r, 0, PGSIZE);
+
+  acquire(&kmem.lock);
+  r->next = kmem.zeroed;
+  kmem.zeroed = r;
+  kmem.nzeroed++;
+  release(&kmem.lock);
+  return 1;
+}
+
 uint64 
 Kfreepages(void)
 {
@@ -125,6 +316,9 @@ Kfreepages(void)
     number_of_pages++;
     r = r->next;
   }
+  number_of_pages += kmem.nzeroed;
+  number_of_pages += kmem.nsubfree;
+  number_of_pages += (uint64)kmem.nsuper * (SUPERPGSIZE / PGSIZE);
   release(&kmem.lock);
   
   return number_of_pages;
@@ -6,6 +6,7 @@
 #include "sleeplock.h"
 #include "fs.h"
 #include "buf.h"
+#include "iostat.h"
 
 // Simple logging that allows concurrent FS system calls.
 //
@@ -21,6 +22,15 @@
 // But if it thinks the log is close to running out, it
 // sleeps until the last outstanding end_op() commits.
 //
+// Committing only appends the transaction's blocks to the log
+// and rewrites the header; the blocks stay pinned in the
+// buffer cache. Installing them at their home locations (a
+// checkpoint) waits until the log is half full, so that a
+// block written by many transactions, like a bitmap or inode
+// block, goes home once. A checkpoint installs each block
+// from the cache, all writes in flight at once, then empties
+// the log.
+//
 // The log is a physical re-do log containing disk blocks.
 // The on-disk log format:
 //   header block, containing block #s for block A, B, C, ...
@@ -28,7 +38,8 @@
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+// Log appends are synchronous. A block may appear more than
+// once in the log; the last copy is the one that counts.
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
@@ -40,14 +51,18 @@ struct logheader {
 struct log {
   struct spinlock lock;
   int start;
+  int size;        // data blocks in the on-disk log
   int outstanding; // how many FS sys calls are executing.
   int committing;  // in commit(), please wait.
+  int committed;   // lh.block[0..committed) are committed
   int dev;
   struct logheader lh;
+  uint64 ncommit, ncheckpoint, nabsorbed;
 };
 struct log log;
 
 static void recover_from_log(void);
+static void write_head(void);
 static void commit();
 
 void
@@ -58,29 +73,76 @@ initlog(int dev, struct superblock *sb)
 
   initlock(&log.lock, "log");
   log.start = sb->logstart;
+  log.size = sb->nlog - 1;
+  if (log.size > LOGBLOCKS)
+    log.size = LOGBLOCKS;
+  if (log.size < 2*MAXOPBLOCKS)
+    panic("initlog: log too small");
   log.dev = dev;
   recover_from_log();
 }
 
-// Copy committed blocks from log to their home location
+// Is block i of the log overwritten by a later copy?
+static int
+superseded(int i)
+{
+  for (int j = i+1; j < log.lh.n; j++)
+    if (log.lh.block[j] == log.lh.block[i])
+      return 1;
+  return 0;
+}
+
+// After a crash, copy committed blocks from log to their
+// home location, NBATCH blocks at a time.
 static void
-install_trans(int recovering)
+install_trans(void)
 {
-  int tail;
+  struct buf *dbuf[NBATCH];
+  int tail, n, i;
 
-  for (tail = 0; tail < log.lh.n; tail++) {
-    if(recovering) {
+  for (tail = 0; tail < log.lh.n; ) {
+    for (n = 0; n < NBATCH && tail < log.lh.n; tail++) {
+      if (superseded(tail))
+        continue;
       printf("recovering tail %d dst %d\n", tail, log.lh.block[tail]);
+      struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
+      dbuf[n] = bread(log.dev, log.lh.block[tail]); // read dst
+      memmove(dbuf[n]->data, lbuf->data, BSIZE);  // copy block to dst
+      brelse(lbuf);
+      n++;
     }
-    struct buf *lbuf = bread(log.dev, log.start+tail+1); // read log block
-    struct buf *dbuf = bread(log.dev, log.lh.block[tail]); // read dst
-    memmove(dbuf->data, lbuf->data, BSIZE);  // copy block to dst
-    bwrite(dbuf);  // write dst to disk
-    if(recovering == 0)
-      bunpin(dbuf);
-    brelse(lbuf);
-    brelse(dbuf);
+    bwritev(dbuf, n);  // write dst to disk
+    for (i = 0; i < n; i++)
+      brelse(dbuf[i]);
+  }
+}
+
+// Write every committed block home from the cache, where
+// its pinned copy is the latest, with all of the writes in
+// flight at once; then unpin them and empty the log.
+// No FS system call may be running.
+static void
+checkpoint(void)
+{
+  // Too big for the kernel stack; log.committing keeps a
+  // second checkpoint out.
+  static struct buf *dbuf[LOGBLOCKS];
+  int i, n = 0;
+
+  for (i = 0; i < log.lh.n; i++)
+    if (!superseded(i))
+      dbuf[n++] = bread(log.dev, log.lh.block[i]);
+  for (i = 0; i < n; i += NBATCH)
+    bstartwrite(dbuf+i, n-i < NBATCH ? n-i : NBATCH);
+  for (i = 0; i < n; i++) {
+    bwait(dbuf[i]);
+    bunpin(dbuf[i]);
+    brelse(dbuf[i]);
   }
+  log.lh.n = 0;
+  log.committed = 0;
+  write_head();    // Erase the transactions from the log
+  log.ncheckpoint++;
 }
 
 // Read the log header from disk into the in-memory log header
@@ -90,6 +152,8 @@ read_head(void)
   struct buf *buf = bread(log.dev, log.start);
   struct logheader *lh = (struct logheader *) (buf->data);
   int i;
+  if (lh->n < 0 || lh->n > log.size)
+    panic("read_head");
   log.lh.n = lh->n;
   for (i = 0; i < log.lh.n; i++) {
     log.lh.block[i] = lh->block[i];
@@ -118,7 +182,7 @@ static void
 recover_from_log(void)
 {
   read_head();
-  install_trans(1); // if committed, copy from log to disk
+  install_trans(); // if committed, copy from log to disk
   log.lh.n = 0;
   write_head(); // clear the log
 }
@@ -131,7 +195,7 @@ begin_op(void)
   while(1){
     if(log.committing){
       sleep(&log, &log.lock);
-    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > LOGBLOCKS){
+    } else if(log.lh.n + (log.outstanding+1)*MAXOPBLOCKS > log.size){
       // this op might exhaust log space; wait for commit.
       sleep(&log, &log.lock);
     } else {
@@ -175,32 +239,38 @@ end_op(void)
   }
 }
 
-// Copy modified blocks from cache to log.
+// Copy blocks modified since the last commit from cache to
+// log, NBATCH at a time.
 static void
 write_log(void)
 {
-  int tail;
-
-  for (tail = 0; tail < log.lh.n; tail++) {
-    struct buf *to = bread(log.dev, log.start+tail+1); // log block
-    struct buf *from = bread(log.dev, log.lh.block[tail]); // cache block
-    memmove(to->data, from->data, BSIZE);
-    bwrite(to);  // write the log
-    brelse(from);
-    brelse(to);
+  struct buf *to[NBATCH];
+  int tail, n, i;
+
+  for (tail = log.committed; tail < log.lh.n; tail += n) {
+    for (n = 0; n < NBATCH && tail+n < log.lh.n; n++) {
+      to[n] = bread(log.dev, log.start+tail+n+1); // log block
+      struct buf *from = bread(log.dev, log.lh.block[tail+n]); // cache block
+      memmove(to[n]->data, from->data, BSIZE);
+      brelse(from);
+    }
+    bwritev(to, n);  // write the log
+    for (i = 0; i < n; i++)
+      brelse(to[i]);
   }
 }
 
 static void
 commit()
 {
-  if (log.lh.n > 0) {
+  if (log.lh.n > log.committed) {
     write_log();     // Write modified blocks from cache to log
     write_head();    // Write header to disk -- the real commit
-    install_trans(0); // Now install writes to home locations
-    log.lh.n = 0;
-    write_head();    // Erase the transaction from the log
+    log.committed = log.lh.n;
+    log.ncommit++;
   }
+  if (log.committed > log.size/2)
+    checkpoint();    // Now install writes to home locations
 }
 
 // Caller has modified b->data and is done with the buffer.
@@ -215,23 +285,42 @@ commit()
 void
 log_write(struct buf *b)
 {
-  int i;
+  int i, pinned = 0;
 
   acquire(&log.lock);
-  if (log.lh.n >= LOGBLOCKS)
-    panic("too big a transaction");
   if (log.outstanding < 1)
     panic("log_write outside of trans");
 
   for (i = 0; i < log.lh.n; i++) {
-    if (log.lh.block[i] == b->blockno)   // log absorption
-      break;
+    if (log.lh.block[i] == b->blockno) {
+      if (i >= log.committed) {   // log absorption
+        log.nabsorbed++;
+        break;
+      }
+      pinned = 1;  // still pinned by a committed transaction
+    }
   }
+  if (i == log.size)
+    panic("too big a transaction");
   log.lh.block[i] = b->blockno;
   if (i == log.lh.n) {  // Add new block to log?
-    bpin(b);
+    if (!pinned)
+      bpin(b);
     log.lh.n++;
   }
   release(&log.lock);
 }
 
+// Fill in how many transactions were committed and
+// checkpointed, and how many block writes the log absorbed.
+void
+logstat(struct logstat *st)
+{
+  acquire(&log.lock);
+  st->size = log.size;
+  st->used = log.lh.n;
+  st->ncommit = log.ncommit;
+  st->ncheckpoint = log.ncheckpoint;
+  st->nabsorbed = log.nabsorbed;
+  release(&log.lock);
+}
@@ -19,7 +19,9 @@ main()
     kinit();         // physical page allocator
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
+    slabinit();      // slab caches for small kernel objects
     procinit();      // process table
+    schedtraceinit(); // scheduler event trace
     trapinit();      // trap vectors
     trapinithart();  // install kernel trap vector
     plicinit();      // set up interrupt controller
@@ -27,6 +29,7 @@ main()
     binit();         // buffer cache
     iinit();         // inode table
     fileinit();      // file table
+    pipeinit();      // pipe slab cache
     virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
     __sync_synchronize();
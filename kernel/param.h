@@ -1,15 +1,27 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
+#define ALLCPUS      ((1L << NCPU) - 1)  // affinity mask of every CPU
+#define NPRIO         4  // scheduling priorities (0-3)
+#define NWAITQ       64  // wait channel hash buckets
 #define NOFILE       16  // open files per process
+#define NVMA         16  // mmap regions per process
 #define NFILE       100  // open files per system
 #define NINODE       50  // maximum number of active i-nodes
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
-#define MAXOPBLOCKS  10  // max # of blocks any FS op writes
-#define LOGBLOCKS    (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       4000  // size of file system in blocks
+#define NSEG          8  // max loadable segments per program
+#define MAXOPBLOCKS  20  // max # of blocks any FS op writes
+#ifndef LOGBLOCKS
+#define LOGBLOCKS    (MAXOPBLOCKS*12) // max data blocks in on-disk log; at most 254
+#endif
+#define NBATCH       8     // most disk requests bio starts at once
+#define NBUF         (LOGBLOCKS+2*NBATCH)  // minimum size of disk block cache
+#define FSSIZE       70000 // size of file system in blocks
+#define NDCACHE      256   // directory entry cache slots
 #define MAXPATH      128   // maximum file path name
 #define USERSTACK    1     // user stack pages
+#define NSUPERPG     8     // 2MB megapages reserved for user heaps
+#define TICKCYCLES   1000000 // timer tick in time-CSR cycles (~0.1 s)
+#define IDLETICKS    10    // longest an idle hart sleeps, in ticks
 
@@ -4,6 +4,10 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
+#include "pstat.h"
+#include "schedstat.h"
+#include "schedtrace.h"
 #include "defs.h"
 
 struct cpu cpus[NCPU];
@@ -17,6 +21,7 @@ struct spinlock pid_lock;
 
 extern void forkret(void);
 static void freeproc(struct proc *p);
+static int runqidlest(uint64 mask);
 
 extern char trampoline[]; // trampoline.S
 
@@ -26,6 +31,413 @@ extern char trampoline[]; // trampoline.S
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
+// FIFO run queues of RUNNABLE processes, one per priority,
+// kept separately for each hart. A process goes back on the
+// queue of the hart it last ran on, so it tends to find its
+// cache state still warm; a hart with nothing queued steals
+// from the busiest other hart.
+//
+// Each hart works its queues in passes: a pass at level L
+// serves queues NPRIO-1 down to L, taking from each only the
+// processes that were queued when it got there, and L cycles
+// NPRIO-1..0. So priority n gets n+1 turns per cycle and
+// priority 0 still runs once per cycle.
+//
+// Processes in the stride class sit on a separate list per
+// hart, sorted by pass; see runqget().
+//
+// A runq's lock is acquired after p->lock, and never
+// together with another runq's lock.
+struct runq {
+  struct spinlock lock;
+  struct proc *head[NPRIO];
+  struct proc *tail[NPRIO];
+  int n[NPRIO];    // length of each queue
+  int nrunnable;   // total over all queues
+  int level;       // lowest priority served this pass
+  int cur;         // queue being served
+  int left;        // picks left from cur
+
+  struct proc *rthead; // real-time processes, FIFO
+  struct proc *rttail;
+  int nrt;         // length of real-time queue
+  struct proc *stride; // stride-class processes, lowest pass first
+  int nstride;     // length of stride list
+  uint64 pass;     // pass of the last stride process picked
+  uint64 mlfqpass; // pass of the feedback queues as a whole
+  int idle;        // hart is asleep in wfi; don't queue here
+  int online;      // hart has entered scheduler()
+
+  // statistics, updated only by the owning hart.
+  uint64 nsched;   // processes run
+  uint64 steals;   // processes taken from another hart's queue
+  uint64 migrations; // processes that last ran on another hart
+} runqs[NCPU];
+
+// May p run on hart id?
+#define ONCPU(p, id)  (((p)->affinity >> (id)) & 1)
+
+// Priorities move as in a multi-level feedback queue. A
+// process starts at its base priority, NPRIO-1 - nice_lv.
+// Using up a whole quantum (which is longer at lower
+// priorities) drops it one level; blocking before then
+// raises it one level, up to its base. Every BOOSTTICKS
+// ticks all processes go back to their base priority, so
+// a process demoted during a CPU-bound phase recovers.
+#define BOOSTTICKS    100
+
+// Ticks a process may run at each priority before it is
+// demoted; set with quantum().
+static int quantum[NPRIO] = { 4, 3, 2, 1 };
+
+// Stride scheduling: a process holds tickets according to its
+// nice level, and each time it is picked its pass advances by
+// STRIDE1 / tickets; the lowest pass runs next, so CPU time
+// follows the ticket ratio (4:3:2:1 for nice 0..3). The
+// feedback queues as a whole take part as one more client
+// with MLFQTICKETS, so neither class can starve the other.
+#define STRIDE1       (1 << 20)
+#define TICKETS(nice) (100 * (NPRIO - (nice)))
+#define MLFQTICKETS   TICKETS(0)
+
+// Real-time processes run ahead of both other classes, in
+// FIFO order, while they stay within their budget: rtbudget
+// ticks out of every rtperiod. Waking one queues it on the
+// waking hart and switches to it as soon as that hart leaves
+// its current trap. One that has used up its budget is
+// throttled: it is queued at the lowest MLFQ priority until
+// its next period begins.
+
+// Is p real-time and within its budget? Caller holds p->lock.
+static int
+rtactive(struct proc *p)
+{
+  if(p->sclass != SCHED_RT)
+    return 0;
+  if(ticks - p->rtstart >= p->rtperiod){
+    p->rtstart = ticks;
+    p->rtused = 0;
+  }
+  return p->rtused < p->rtbudget;
+}
+
+// Class for new processes; build with SCHED=STRIDE to change.
+#ifndef SCHED_DEFAULT
+#define SCHED_DEFAULT SCHED_MLFQ
+#endif
+
+static int
+basepri(struct proc *p)
+{
+  return NPRIO-1 - p->nice_lv;
+}
+
+// Sleeping processes, hashed by channel, so that wakeup()
+// only looks at processes that may be sleeping on its
+// channel. A queue's lock is acquired before p->lock.
+struct waitq {
+  struct spinlock lock;
+  struct proc *head;
+
+  // wakeup() cost, for wakestat().
+  uint64 calls;      // wakeup()s that hashed here
+  uint64 examined;   // sleepers looked at
+  uint64 woken;      // sleepers made RUNNABLE
+} waitqs[NWAITQ];
+
+static struct waitq*
+waitq(void *chan)
+{
+  uint64 h = (uint64)chan;
+  return &waitqs[(h ^ (h >> 6) ^ (h >> 12)) % NWAITQ];
+}
+
+// Unlink p from wq. Caller must hold wq->lock.
+static void
+waitqremove(struct waitq *wq, struct proc *p)
+{
+  struct proc **pp;
+
+  for(pp = &wq->head; *pp; pp = &(*pp)->wqnext){
+    if(*pp == p){
+      *pp = p->wqnext;
+      break;
+    }
+  }
+  p->wqnext = 0;
+  p->inwq = 0;
+}
+
+// Send hart id a software interrupt (see ipivec in
+// kernelvec.S), waking it from wfi.
+static void
+wakehart(int id)
+{
+  *(volatile uint32*)CLINT_MSIP(id) = 1;
+}
+
+// Mark p RUNNABLE and append it to the queue for its
+// priority on the hart it last ran on.
+// Caller must hold p->lock.
+static void
+setrunnable(struct proc *p)
+{
+  struct runq *rq;
+  struct proc **pp, *cur;
+  int q, rt, wake;
+
+  p->state = RUNNABLE;
+  p->stamp = r_time();
+  wake = 0;
+
+  // run a real-time process here, not on the hart it last
+  // used, so that it need not wait for that hart's next tick.
+  rt = rtactive(p);
+  if(rt && ONCPU(p, cpuid()))
+    p->cpu = cpuid();
+  if(!ONCPU(p, p->cpu))
+    p->cpu = runqidlest(p->affinity);
+
+  // apply a priority boost p missed while it was not queued.
+  if(p->sclass == SCHED_MLFQ && p->boost != ticks / BOOSTTICKS){
+    p->boost = ticks / BOOSTTICKS;
+    p->priority = basepri(p);
+    p->qticks = 0;
+  }
+
+  rq = &runqs[p->cpu];
+  acquire(&rq->lock);
+  if(rq->idle && p->cpu != cpuid() && ONCPU(p, cpuid())){
+    // that hart is asleep; rather than wake it, queue on
+    // this hart, which is awake.
+    release(&rq->lock);
+    p->cpu = cpuid();
+    rq = &runqs[p->cpu];
+    acquire(&rq->lock);
+  }
+
+  if(rt){
+    p->rqnext = 0;
+    if(rq->rttail)
+      rq->rttail->rqnext = p;
+    else
+      rq->rthead = p;
+    rq->rttail = p;
+    rq->nrt++;
+    // have the hart p is queued on switch to it when it next
+    // leaves a trap; another hart needs an interrupt to get
+    // there soon.
+    cur = cpus[p->cpu].proc;
+    if(cur && cur != p && cur->sclass != SCHED_RT){
+      cpus[p->cpu].resched = 1;
+      if(p->cpu != cpuid())
+        wake = 1;
+    }
+  } else if(p->sclass == SCHED_STRIDE){
+    // no credit for time spent asleep or on another hart,
+    // against either class.
+    if(p->pass < rq->pass)
+      p->pass = rq->pass;
+    if(p->pass < rq->mlfqpass)
+      p->pass = rq->mlfqpass;
+    for(pp = &rq->stride; *pp && (*pp)->pass <= p->pass; pp = &(*pp)->rqnext)
+      ;
+    p->rqnext = *pp;
+    *pp = p;
+    rq->nstride++;
+  } else {
+    q = p->sclass == SCHED_RT ? 0 : p->priority;
+    p->rqnext = 0;
+    if(rq->tail[q])
+      rq->tail[q]->rqnext = p;
+    else
+      rq->head[q] = p;
+    rq->tail[q] = p;
+    rq->n[q]++;
+  }
+  rq->nrunnable++;
+  if(rq->idle && p->cpu != cpuid())
+    wake = 1;
+  release(&rq->lock);
+
+  // an idle hart won't look at its queue until its timer
+  // fires, up to IDLETICKS away; interrupt its wfi now.
+  if(wake)
+    wakehart(p->cpu);
+}
+
+// Remove and return the next process to run from rq, or 0
+// if it is empty. Does not take p->lock.
+static struct proc*
+runqget(struct runq *rq)
+{
+  struct proc *p;
+  int q;
+
+  acquire(&rq->lock);
+  if(rq->nrunnable == 0){
+    release(&rq->lock);
+    return 0;
+  }
+
+  if(rq->nrt > 0){
+    p = rq->rthead;
+    rq->rthead = p->rqnext;
+    if(rq->rthead == 0)
+      rq->rttail = 0;
+    p->rqnext = 0;
+    rq->nrt--;
+    rq->nrunnable--;
+    release(&rq->lock);
+    return p;
+  }
+
+  if(rq->mlfqpass < rq->pass)
+    rq->mlfqpass = rq->pass;
+  if(rq->nstride == rq->nrunnable ||
+     (rq->nstride > 0 && rq->stride->pass <= rq->mlfqpass)){
+    p = rq->stride;
+    rq->stride = p->rqnext;
+    p->rqnext = 0;
+    rq->nstride--;
+    rq->nrunnable--;
+    rq->pass = p->pass;
+    p->pass += STRIDE1 / TICKETS(p->nice_lv);
+    release(&rq->lock);
+    return p;
+  }
+  rq->mlfqpass += STRIDE1 / MLFQTICKETS;
+
+  while(rq->left == 0 || rq->head[rq->cur] == 0){
+    // move on to the next queue, or start the next pass.
+    if(rq->cur > rq->level){
+      rq->cur--;
+    } else {
+      rq->level = rq->level == 0 ? NPRIO-1 : rq->level-1;
+      rq->cur = NPRIO-1;
+    }
+    rq->left = rq->n[rq->cur];
+  }
+  q = rq->cur;
+  p = rq->head[q];
+  rq->head[q] = p->rqnext;
+  if(rq->head[q] == 0)
+    rq->tail[q] = 0;
+  p->rqnext = 0;
+  rq->n[q]--;
+  rq->nrunnable--;
+  rq->left--;
+  release(&rq->lock);
+  return p;
+}
+
+// Unlink the first process on list *head that may run on
+// hart self, keeping *tail right. Returns 0 if there is none.
+static struct proc*
+unlinkfor(struct proc **head, struct proc **tail, int self)
+{
+  struct proc **pp, *p, *prev = 0;
+
+  for(pp = head; (p = *pp) != 0; prev = p, pp = &p->rqnext){
+    if(ONCPU(p, self)){
+      *pp = p->rqnext;
+      if(tail && *tail == p)
+        *tail = prev;
+      p->rqnext = 0;
+      return p;
+    }
+  }
+  return 0;
+}
+
+// Take a process that may run on hart self from rq, real-time
+// first, then by priority, then stride.
+static struct proc*
+runqtake(struct runq *rq, int self)
+{
+  struct proc *p;
+  int q;
+
+  acquire(&rq->lock);
+  if((p = unlinkfor(&rq->rthead, &rq->rttail, self)) != 0){
+    rq->nrt--;
+  } else {
+    for(q = NPRIO-1; q >= 0; q--){
+      if((p = unlinkfor(&rq->head[q], &rq->tail[q], self)) != 0){
+        rq->n[q]--;
+        break;
+      }
+    }
+    if(p == 0 && (p = unlinkfor(&rq->stride, 0, self)) != 0)
+      rq->nstride--;
+  }
+  if(p)
+    rq->nrunnable--;
+  release(&rq->lock);
+  return p;
+}
+
+// Take a process from the online hart with the longest
+// queue. The lengths are read without locks; a stale guess
+// only costs an empty runqtake().
+static struct proc*
+runqsteal(int self)
+{
+  struct runq *busiest = 0;
+  int most = 0;
+
+  for(int i = 0; i < NCPU; i++){
+    if(i != self && runqs[i].online && runqs[i].nrunnable > most){
+      most = runqs[i].nrunnable;
+      busiest = &runqs[i];
+    }
+  }
+  if(busiest == 0)
+    return 0;
+  return runqtake(busiest, self);
+}
+
+// The online, awake hart in mask with the fewest queued
+// processes, preferring this one; failing that, any online
+// hart in mask. Called with interrupts off.
+static int
+runqidlest(uint64 mask)
+{
+  int best = -1, any = -1;
+
+  if(mask & (1L << cpuid()))
+    best = cpuid();
+  for(int i = 0; i < NCPU; i++){
+    if(!(mask & (1L << i)) || !runqs[i].online)
+      continue;
+    if(any < 0)
+      any = i;
+    if(!runqs[i].idle &&
+       (best < 0 || runqs[i].nrunnable < runqs[best].nrunnable))
+      best = i;
+  }
+  if(best >= 0)
+    return best;
+  if(any >= 0)
+    return any;
+  return cpuid();
+}
+
+// Mark rq idle if it is still empty, so that setrunnable()
+// stops queueing work here. Returns 1 if the hart may sleep.
+static int
+runqidle(struct runq *rq)
+{
+  int empty;
+
+  acquire(&rq->lock);
+  empty = rq->nrunnable == 0;
+  if(empty)
+    rq->idle = 1;
+  release(&rq->lock);
+  return empty;
+}
+
 // Allocate a page for each process's kernel stack.
 // Map it high in memory, followed by an invalid
 // guard page.
@@ -51,6 +463,10 @@ procinit(void)
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&runqs[i].lock, "runq");
+  for(int i = 0; i < NWAITQ; i++)
+    initlock(&waitqs[i].lock, "waitq");
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
       p->state = UNUSED;
@@ -125,10 +541,19 @@ found:
   p->pid = allocpid();
   p->state = USED;
   p->countp = 0;
-
-  // Initialize mmap fields
-  p->mmap = 0;          
-  p->has_mmap = 0;
+  p->nice_lv = 0;
+  p->priority = basepri(p);
+  p->qticks = 0;
+  p->sclass = SCHED_DEFAULT;
+  p->pass = 0;
+  p->affinity = ALLCPUS;
+  p->rtime = p->wtime = 0;
+  p->nvcsw = p->nivcsw = p->nfaults = 0;
+  p->boost = ticks / BOOSTTICKS;
+
+  // No mmap regions yet.
+  p->mmap = TRAPFRAME;
+  memset(p->vma, 0, sizeof(p->vma));
   
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -160,23 +585,6 @@ found:
 static void
 freeproc(struct proc *p)
 {
-  if(p->trapframe)
-    kfree((void*)p->trapframe);
-  p->trapframe = 0;
-  
-  // Clean up mmap pages if they exist
-  if(p->has_mmap) {
-    uint64 va = TRAPFRAME - PGSIZE;
-    while(va > p->mmap) {
-      uint64 pa = walkaddr(p->pagetable, va);
-      if(pa != 0) {
-        uvmunmap(p->pagetable, va, 1, 1);  // Unmap and free
-      }
-      va -= PGSIZE;
-    }
-    p->has_mmap = 0;
-  }
-
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
@@ -192,6 +600,8 @@ freeproc(struct proc *p)
   p->xstate = 0;
   p->state = UNUSED;
   p->stracing = 0;
+  p->execip = 0;
+  p->nseg = 0;
 }
 
 // Create a user page table for a given process, with no user memory,
@@ -249,7 +659,7 @@ userinit(void)
   
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  setrunnable(p);
 
   release(&p->lock);
 }
@@ -296,44 +706,48 @@ kfork(void)
   }
   np->sz = p->sz;
 
+  // mmapcopy() may sleep faulting in file pages. np is still
+  // USED, so nothing else looks at it meanwhile.
+  release(&np->lock);
+  int err = mmapcopy(p, np);
+  acquire(&np->lock);
+  if(err < 0){
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
+
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
 
   // Cause fork to return 0 in the child.
   np->trapframe->a0 = 0;
 
-  //Lab09
-  if(p->has_mmap) {
-    np->mmap = p->mmap;
-    np->has_mmap = 1;
-    
-    // Map each page from parent to child
-    uint64 va = TRAPFRAME - PGSIZE;
-    while(va > p->mmap) {
-      uint64 pa = walkaddr(p->pagetable, va);
-      if(pa != 0) {
-        // Map the same physical page in the child
-        if(mappages(np->pagetable, va, PGSIZE, pa, PTE_R | PTE_W | PTE_U) != 0) {
-          freeproc(np);
-          release(&np->lock);
-          return -1;
-        }
-        // Increment reference count for the shared page
-        krefpage((void*)pa);
-      }
-      va -= PGSIZE;
-    }
-  }
-
   // increment reference counts on open file descriptors.
   for(i = 0; i < NOFILE; i++)
     if(p->ofile[i])
       np->ofile[i] = filedup(p->ofile[i]);
   np->cwd = idup(p->cwd);
+  if(p->execip){
+    np->execip = idup(p->execip);
+    iexec(np->execip, 1);
+  }
+  memmove(np->seg, p->seg, sizeof(p->seg));
+  np->nseg = p->nseg;
 
   safestrcpy(np->name, p->name, sizeof(p->name));
 
+  // the child keeps the parent's nice level, at full priority.
+  np->nice_lv = p->nice_lv;
+  np->priority = basepri(np);
+  np->affinity = p->affinity;
+  // real-time is not inherited, so an RT shell's
+  // commands do not run ahead of everything else.
+  np->sclass = p->sclass == SCHED_RT ? SCHED_DEFAULT : p->sclass;
+  np->pass = p->pass;
+
   pid = np->pid;
+  schedtrace(SE_FORK, pid, p->pid);
 
   release(&np->lock);
 
@@ -342,7 +756,8 @@ kfork(void)
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  np->cpu = runqidlest(np->affinity);
+  setrunnable(np);
   release(&np->lock);
 
   return pid;
@@ -374,6 +789,9 @@ kexit(int status)
   if(p == initproc)
     panic("init exiting");
 
+  // Write back and drop mmap regions while the files are open.
+  munmapall(p);
+
   // Close all open files.
   for(int fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd]){
@@ -385,8 +803,13 @@ kexit(int status)
 
   begin_op();
   iput(p->cwd);
+  if(p->execip){
+    iexec(p->execip, -1);
+    iput(p->execip);
+  }
   end_op();
   p->cwd = 0;
+  p->execip = 0;
 
   acquire(&wait_lock);
 
@@ -400,6 +823,7 @@ kexit(int status)
 
   p->xstate = status;
   p->state = ZOMBIE;
+  schedtrace(SE_EXIT, p->pid, status);
 
   release(&wait_lock);
 
@@ -417,6 +841,10 @@ kwait(uint64 addr)
   int havekids, pid;
   struct proc *p = myproc();
 
+  // copyout() below runs with spinlocks held, so it can't
+  // read in a page of a file; do that now.
+  if(addr != 0)
+    uvmprefault(p, addr, sizeof(int));
   acquire(&wait_lock);
 
   for(;;){
@@ -467,6 +895,11 @@ kwait2(uint64 status, uint64 count)
   int havekids, pid;
   struct proc *p = myproc();
 
+  // as in kwait().
+  if(status != 0)
+    uvmprefault(p, status, sizeof(int));
+  if(count != 0)
+    uvmprefault(p, count, sizeof(int));
   acquire(&wait_lock);
 
   for(;;){
@@ -530,8 +963,11 @@ scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  int id = cpuid();
+  struct runq *rq = &runqs[id];
 
   c->proc = 0;
+  rq->online = 1;
   for(;;){
     // The most recent process to run may have had interrupts
     // turned off; enable them to avoid a deadlock if all
@@ -542,31 +978,61 @@ scheduler(void)
     intr_off();
 
     int found = 0;
-    for (int current = 3; current >= 0; current--) {
-    //for loop outsite 
-      for(p = proc; p < &proc[NPROC]; p++) {
-      
+    p = runqget(rq);
+    if(p == 0 && (p = runqsteal(id)) != 0)
+      rq->steals++;
+    if(p != 0) {
+      // p may still be on its way into sched() on another
+      // hart; its p->lock is held until it has switched out.
       acquire(&p->lock);
-      if(p->state == RUNNABLE && p->priority >= current) {
-        // Switch to chosen process.  It is the process's job
-        // to release its lock and then reacquire it
-        // before jumping back to us.
-        p->state = RUNNING;
-        c->proc = p;
-        swtch(&c->context, &p->context);
-
-        // Process is done running for now.
-        // It should have changed its p->state before coming back.
-        c->proc = 0;
-        found = 1;
+      if(p->state != RUNNABLE)
+        panic("scheduler: not runnable");
+      if(!ONCPU(p, id)){
+        // its affinity changed while it was queued here.
+        setrunnable(p);
+        release(&p->lock);
+        continue;
+      }
+      rq->nsched++;
+      if(p->cpu != id){
+        rq->migrations++;
+        p->cpu = id;
       }
+      // Switch to chosen process.  It is the process's job
+      // to release its lock and then reacquire it
+      // before jumping back to us.
+      p->state = RUNNING;
+      uint64 now = r_time();
+      p->wtime += now - p->stamp;
+      p->stamp = now;
+      c->proc = p;
+      c->resched = 0;
+      schedtrace(SE_SWITCHIN, p->pid, 0);
+      swtch(&c->context, &p->context);
+      schedtrace(SE_SWITCHOUT, p->pid, p->state);
+
+      // Process is done running for now.
+      // It should have changed its p->state before coming back.
+      // (p->stamp may have been reset by setrunnable().)
+      p->rtime += r_time() - now;
+      c->proc = 0;
+      found = 1;
       release(&p->lock);
     }
-   }
-    if(found == 0) {
-      // nothing to run; stop running on this core until an interrupt.
-      intr_on(); 
+    if(found == 0 && kzero_idle() == 0 && runqidle(rq)) {
+      // nothing to run and no pages left to pre-zero;
+      // stop running on this core until an interrupt,
+      // without waking for ticks nobody is waiting for.
+      // wfi returns once an interrupt is pending, even with
+      // interrupts off, so a wakehart() that came after
+      // runqidle() still ends it; the interrupt itself is
+      // taken at the top of the loop.
+      tickidle();
       asm volatile("wfi");
+      acquire(&rq->lock);
+      rq->idle = 0;
+      release(&rq->lock);
+      w_stimecmp(r_time() + TICKCYCLES);
     }
   }
 }
@@ -604,11 +1070,176 @@ yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
-  p->state = RUNNABLE;
+  p->nvcsw++;
+  setrunnable(p);
   sched();
   release(&p->lock);
 }
 
+// Called on each timer interrupt. Charge the tick to the
+// current process, and once its quantum is used up, demote
+// it and give up the CPU. Stride processes always give up
+// the CPU; their share is kept by the pass values instead.
+void
+preempt(void)
+{
+  struct proc *p = myproc();
+  acquire(&p->lock);
+  if(p->sclass == SCHED_RT && rtactive(p)){
+    // keep running until the budget is gone, but take
+    // turns with other real-time processes.
+    p->rtused++;
+    if(p->rtused < p->rtbudget && runqs[p->cpu].nrt == 0){
+      release(&p->lock);
+      return;
+    }
+  } else if(p->sclass == SCHED_MLFQ){
+    if(++p->qticks < quantum[p->priority]){
+      release(&p->lock);
+      return;
+    }
+    p->qticks = 0;
+    if(p->priority > 0)
+      p->priority--;
+  }
+  if(runqs[p->cpu].nrunnable == 0 && ONCPU(p, p->cpu)){
+    // nothing else wants this hart; keep running.
+    release(&p->lock);
+    return;
+  }
+  p->nivcsw++;
+  setrunnable(p);
+  sched();
+  release(&p->lock);
+}
+
+// Called on the way out of a trap. If setrunnable() queued a
+// real-time process on this hart meanwhile, switch to it now.
+void
+rtpreempt(void)
+{
+  struct proc *p = myproc();
+  int resched;
+
+  // another hart's setrunnable() may set resched meanwhile.
+  push_off();
+  resched = __sync_lock_test_and_set(&mycpu()->resched, 0);
+  pop_off();
+  if(!resched || p == 0)
+    return;
+
+  acquire(&p->lock);
+  p->nivcsw++;
+  setrunnable(p);
+  sched();
+  release(&p->lock);
+}
+
+// Set p's nice level; it restarts at its new base priority.
+void
+setnice(struct proc *p, int n)
+{
+  acquire(&p->lock);
+  p->nice_lv = n;
+  p->priority = basepri(p);
+  p->qticks = 0;
+  release(&p->lock);
+}
+
+// Set the quantum of priority pri to n ticks, if n > 0.
+// Returns the old quantum, or -1 if pri is out of range.
+int
+setquantum(int pri, int n)
+{
+  int old;
+
+  if(pri < 0 || pri >= NPRIO)
+    return -1;
+  old = quantum[pri];
+  if(n > 0)
+    quantum[pri] = n;
+  return old;
+}
+
+// Make p real-time with budget ticks of every period.
+void
+setrt(struct proc *p, int budget, int period)
+{
+  acquire(&p->lock);
+  p->sclass = SCHED_RT;
+  p->rtbudget = budget;
+  p->rtperiod = period;
+  p->rtused = 0;
+  p->rtstart = ticks;
+  release(&p->lock);
+}
+
+// Restrict process pid (0 for the caller) to the harts in
+// mask. Returns -1 if there is no such process or no online
+// hart in mask.
+int
+setaffinity(int pid, uint64 mask)
+{
+  struct proc *p;
+  uint64 online = 0;
+  int moved = 0;
+
+  for(int i = 0; i < NCPU; i++)
+    if(runqs[i].online)
+      online |= 1L << i;
+  if((mask & online) == 0)
+    return -1;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED){
+      p->affinity = mask & ALLCPUS;
+      moved = p == myproc() && !ONCPU(p, p->cpu);
+      release(&p->lock);
+      // the caller leaves a hart it may no longer use.
+      if(moved)
+        yield();
+      return 0;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
+// The hart mask of process pid (0 for the caller), or -1.
+int
+getaffinity(int pid)
+{
+  struct proc *p;
+  int mask;
+
+  if(pid == 0)
+    pid = myproc()->pid;
+  for(p = proc; p < &proc[NPROC]; p++){
+    acquire(&p->lock);
+    if(p->pid == pid && p->state != UNUSED){
+      mask = p->affinity;
+      release(&p->lock);
+      return mask;
+    }
+    release(&p->lock);
+  }
+  return -1;
+}
+
+// Move p to scheduling class c.
+void
+setsched(struct proc *p, int c)
+{
+  acquire(&p->lock);
+  p->sclass = c;
+  p->priority = basepri(p);
+  p->qticks = 0;
+  release(&p->lock);
+}
+
 // A fork child's very first scheduling by scheduler()
 // will swtch to forkret.
 void
@@ -652,6 +1283,7 @@ void
 sleep(void *chan, struct spinlock *lk)
 {
   struct proc *p = myproc();
+  struct waitq *wq = waitq(chan);
   
   // Must acquire p->lock in order to
   // change p->state and then call sched.
@@ -659,21 +1291,42 @@ sleep(void *chan, struct spinlock *lk)
   // guaranteed that we won't miss any wakeup
   // (wakeup locks p->lock),
   // so it's okay to release lk.
+  // Join chan's wait queue first, since wakeup()
+  // takes the queue's lock before p->lock.
 
+  acquire(&wq->lock);
+  p->wqnext = wq->head;
+  wq->head = p;
+  p->inwq = 1;
   acquire(&p->lock);  //DOC: sleeplock1
+  release(&wq->lock);
   release(lk);
 
+  // Blocking before the quantum runs out is a sign of an
+  // interactive process; move it back up.
+  if(p->priority < basepri(p))
+    p->priority++;
+  p->qticks = 0;
+
   // Go to sleep.
   p->chan = chan;
   p->state = SLEEPING;
+  p->nvcsw++;
+  schedtrace(SE_SLEEP, p->pid, 0);
 
   sched();
 
   // Tidy up.
   p->chan = 0;
+  release(&p->lock);
+
+  // kill() wakes a sleeper without taking it off the queue.
+  acquire(&wq->lock);
+  if(p->inwq)
+    waitqremove(wq, p);
+  release(&wq->lock);
 
   // Reacquire original lock.
-  release(&p->lock);
   acquire(lk);
 }
 
@@ -682,17 +1335,45 @@ sleep(void *chan, struct spinlock *lk)
 void
 wakeup(void *chan)
 {
-  struct proc *p;
+  struct waitq *wq = waitq(chan);
+  struct proc *p, *next;
 
-  for(p = proc; p < &proc[NPROC]; p++) {
+  acquire(&wq->lock);
+  wq->calls++;
+  for(p = wq->head; p; p = next) {
+    next = p->wqnext;
     if(p != myproc()){
+      wq->examined++;
       acquire(&p->lock);
-      if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
+      if(p->chan == chan) {
+        waitqremove(wq, p);
+        if(p->state == SLEEPING) {
+          setrunnable(p);
+          wq->woken++;
+          schedtrace(SE_WAKEUP, p->pid, myproc() ? myproc()->pid : 0);
+        }
       }
       release(&p->lock);
     }
   }
+  release(&wq->lock);
+}
+
+// Sum of wakeup() counters over all wait queues:
+// st[0] calls, st[1] sleepers examined, st[2] woken.
+void
+wakestat(uint64 st[3])
+{
+  struct waitq *wq;
+
+  st[0] = st[1] = st[2] = 0;
+  for(wq = waitqs; wq < &waitqs[NWAITQ]; wq++){
+    acquire(&wq->lock);
+    st[0] += wq->calls;
+    st[1] += wq->examined;
+    st[2] += wq->woken;
+    release(&wq->lock);
+  }
 }
 
 // Kill the process with the given pid.
@@ -709,7 +1390,7 @@ kkill(int pid)
       p->killed = 1;
       if(p->state == SLEEPING){
         // Wake process from sleep().
-        p->state = RUNNABLE;
+        setrunnable(p);
       }
       release(&p->lock);
       return 0;
@@ -738,6 +1419,20 @@ killed(struct proc *p)
   return k;
 }
 
+// Can the current process sleep, i.e. does it hold no spinlocks?
+// Page faults taken by copyin()/copyout() that need to read a
+// file check this, since their caller may hold a spinlock.
+int
+cansleep(void)
+{
+  int n;
+
+  push_off();
+  n = mycpu()->noff;
+  pop_off();
+  return n == 1;
+}
+
 // Copy to either a user address, or kernel address,
 // depending on usr_dst.
 // Returns 0 on success, -1 on error.
@@ -768,6 +1463,52 @@ either_copyin(void *dst, int user_src, uint64 src, uint64 len)
   }
 }
 
+// Copy accounting for up to n processes to the user array
+// at addr. Returns the number copied, or -1 on a bad address.
+int
+procstat(uint64 addr, int n)
+{
+  struct proc *p;
+  struct pstat st;
+  int i = 0;
+
+  for(p = proc; p < &proc[NPROC] && i < n; p++){
+    acquire(&wait_lock);
+    acquire(&p->lock);
+    if(p->state == UNUSED){
+      release(&p->lock);
+      release(&wait_lock);
+      continue;
+    }
+    st.pid = p->pid;
+    st.ppid = p->parent ? p->parent->pid : 0;
+    st.state = p->state;
+    st.priority = p->priority;
+    st.nice = p->nice_lv;
+    st.cpu = p->cpu;
+    st.sz = p->sz;
+    st.rtime = p->rtime;
+    st.wtime = p->wtime;
+    // include the slice or wait in progress.
+    if(p->state == RUNNING)
+      st.rtime += r_time() - p->stamp;
+    else if(p->state == RUNNABLE)
+      st.wtime += r_time() - p->stamp;
+    st.nvcsw = p->nvcsw;
+    st.nivcsw = p->nivcsw;
+    st.nfaults = p->nfaults;
+    safestrcpy(st.name, p->name, sizeof(st.name));
+    release(&p->lock);
+    release(&wait_lock);
+
+    // copy out with no locks held; it may fault.
+    if(copyout(myproc()->pagetable, addr + i*sizeof(st), (char*)&st, sizeof(st)) < 0)
+      return -1;
+    i++;
+  }
+  return i;
+}
+
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
 // No lock to avoid wedging a stuck machine further.
@@ -798,3 +1539,28 @@ procdump(void)
     printf("\n");
   }
 }
+
+// Copy out the run queue length and scheduling counters of
+// up to n harts, hart 0 first, to addr, an array of struct
+// schedstat. No locks; the numbers are only a snapshot.
+// Returns the number copied, or -1.
+int
+runqstat(uint64 addr, int n)
+{
+  struct runq *rq;
+  struct schedstat st;
+  int i;
+
+  for(i = 0; i < n && i < NCPU; i++){
+    rq = &runqs[i];
+    st.online = rq->online;
+    st.idle = rq->idle;
+    st.nrunnable = rq->nrunnable;
+    st.nsched = rq->nsched;
+    st.steals = rq->steals;
+    st.migrations = rq->migrations;
+    if(copyout(myproc()->pagetable, addr + i*sizeof(st), (char*)&st, sizeof(st)) < 0)
+      return -1;
+  }
+  return i;
+}
@@ -24,6 +24,7 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  int resched;                // Real-time process queued; switch at trap exit.
 };
 
 extern struct cpu cpus[NCPU];
@@ -79,6 +80,27 @@ struct trapframe {
   /* 280 */ uint64 t6;
 };
 
+// A region created by mmap(); see sysfile.c.
+struct vma {
+  int used;
+  uint64 start;      // page-aligned start address
+  uint64 len;        // length in bytes, page-aligned
+  int prot;          // PROT_READ, PROT_WRITE, PROT_EXEC
+  int flags;         // MAP_SHARED or MAP_PRIVATE, MAP_ANONYMOUS
+  struct file *f;    // backing file, or 0 if anonymous
+  uint off;          // file offset of start
+};
+
+// A program segment that kexec() left to be paged in
+// from p->execip on first touch; see execfault().
+struct execseg {
+  uint64 va;         // page-aligned start address
+  uint64 memsz;      // bytes of memory
+  uint64 filesz;     // bytes backed by the file
+  uint off;          // file offset of va
+  int perm;          // PTE permissions
+};
+
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
 // Per-process state
@@ -91,10 +113,19 @@ struct proc {
   int killed;                  // If non-zero, have been killed
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int cpu;                     // Hart it last ran on
+  uint64 affinity;             // Harts it may run on, one bit each
 
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
 
+  // runq.lock must be held when using this:
+  struct proc *rqnext;         // Next process in its run queue
+
+  // the wait queue's lock must be held when using these:
+  struct proc *wqnext;         // Next sleeper in its wait queue
+  int inwq;                    // If non-zero, on a wait queue
+
   // these are private to the process, so p->lock need not be held.
   uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
@@ -109,7 +140,26 @@ struct proc {
 
   int priority; 			   // Process priority (0-3)
   int nice_lv;				   // Nice level (0-3)
+  int qticks;                  // Ticks used of current quantum
+  uint boost;                  // Last priority boost applied
+  int sclass;                  // Scheduling class (sched.h)
+  uint64 pass;                 // Stride scheduling pass
+  int rtbudget;                // SCHED_RT: ticks it may run per period
+  int rtperiod;                // SCHED_RT: period in ticks
+  int rtused;                  // SCHED_RT: ticks used this period
+  uint rtstart;                // SCHED_RT: tick this period began
+
+  // accounting, for procstat(); times in time-CSR cycles.
+  uint64 rtime;                // Time spent running
+  uint64 wtime;                // Time spent RUNNABLE
+  uint64 stamp;                // When it last started running or waiting
+  uint64 nvcsw;                // Voluntary context switches
+  uint64 nivcsw;               // Involuntary context switches
+  uint64 nfaults;              // Page faults handled
 
-  uint64 mmap;       // Start address for mmap region
-  int has_mmap;      // Flag: 1 if process has mapped pages
+  struct inode *execip;    // Executable, for demand paging
+  struct execseg seg[NSEG]; // Segments of execip
+  int nseg;
+  uint64 mmap;             // Lowest address used by mmap regions
+  struct vma vma[NVMA];    // mmap regions
 };
@@ -0,0 +1,17 @@
+// Per-process accounting, as returned by procstat().
+// Times are in time-CSR cycles (TICKCYCLES per tick).
+struct pstat {
+  int pid;
+  int ppid;
+  int state;          // enum procstate
+  int priority;
+  int nice;
+  int cpu;            // hart it last ran on
+  uint64 sz;          // bytes of user memory
+  uint64 rtime;       // time spent running
+  uint64 wtime;       // time spent RUNNABLE, waiting for a hart
+  uint64 nvcsw;       // voluntary context switches (sleep, yield)
+  uint64 nivcsw;      // involuntary ones (quantum expired)
+  uint64 nfaults;     // page faults handled
+  char name[16];
+};
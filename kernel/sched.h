@@ -0,0 +1,4 @@
+// Scheduling classes, for setsched().
+#define SCHED_MLFQ    0  // feedback queues over nice levels (default)
+#define SCHED_STRIDE  1  // proportional share, tickets from nice level
+#define SCHED_RT      2  // runs first, within a budget (setrt())
@@ -0,0 +1,10 @@
+// One hart's run queue length and scheduling counters, as
+// returned by schedstat().
+struct schedstat {
+  int online;         // hart has entered scheduler()
+  int idle;           // asleep in wfi
+  int nrunnable;      // processes queued
+  uint64 nsched;      // processes run
+  uint64 steals;      // processes taken from another hart's queue
+  uint64 migrations;  // processes that last ran on another hart
+};
@@ -0,0 +1,107 @@
+// Scheduler event trace.
+//
+// Each hart records events into its own ring with interrupts
+// off, so recording takes no lock: only the owning hart ever
+// writes a ring. schedtrace() drains the rings; a reader that
+// falls more than NTRACE events behind loses the oldest ones.
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "schedtrace.h"
+#include "defs.h"
+
+#define NTRACE 512  // events per hart; a power of two
+
+struct ring {
+  struct schedevent ev[NTRACE];
+  uint64 head;   // events ever written; only the owner writes it
+  uint64 tail;   // next event to drain; under tracelock
+} rings[NCPU];
+
+// serializes readers; writers never take it.
+struct spinlock tracelock;
+
+void
+schedtraceinit(void)
+{
+  initlock(&tracelock, "schedtrace");
+}
+
+// Record an event on this hart's ring.
+void
+schedtrace(int type, int pid, int arg)
+{
+  struct ring *r;
+  struct schedevent *e;
+
+  push_off();
+  r = &rings[cpuid()];
+  e = &r->ev[r->head % NTRACE];
+  e->time = r_time();
+  e->type = type;
+  e->cpu = cpuid();
+  e->pid = pid;
+  e->arg = arg;
+  // publish the event before the new head.
+  __sync_synchronize();
+  r->head++;
+  pop_off();
+}
+
+// Move up to n undrained events into buf, oldest first per
+// hart. Returns the number moved.
+static int
+drain(struct schedevent *buf, int n)
+{
+  struct ring *r;
+  uint64 head, start, lost;
+  int i = 0, i0;
+
+  acquire(&tracelock);
+  for(r = rings; r < &rings[NCPU] && i < n; r++){
+    head = r->head;
+    __sync_synchronize();
+    if(head - r->tail > NTRACE)
+      r->tail = head - NTRACE;
+    start = r->tail;
+    i0 = i;
+    while(r->tail < head && i < n)
+      buf[i++] = r->ev[r->tail++ % NTRACE];
+
+    // drop any that the owner overwrote while we copied.
+    __sync_synchronize();
+    head = r->head;
+    if(head > NTRACE && head - NTRACE > start){
+      lost = head - NTRACE - start;
+      if(lost > i - i0)
+        lost = i - i0;
+      memmove(&buf[i0], &buf[i0 + lost], (i - i0 - lost) * sizeof(buf[0]));
+      i -= lost;
+    }
+  }
+  release(&tracelock);
+  return i;
+}
+
+// Copy up to n events to the user array at addr and remove
+// them from the trace. Returns the number copied, or -1.
+int
+schedtracecopy(pagetable_t pagetable, uint64 addr, int n)
+{
+  struct schedevent buf[16];
+  int m, total = 0;
+
+  while(total < n){
+    m = n - total;
+    if(m > NELEM(buf))
+      m = NELEM(buf);
+    if((m = drain(buf, m)) == 0)
+      break;
+    if(copyout(pagetable, addr + total*sizeof(buf[0]), (char*)buf, m*sizeof(buf[0])) < 0)
+      return -1;
+    total += m;
+  }
+  return total;
+}
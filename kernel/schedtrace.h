@@ -0,0 +1,16 @@
+// Scheduler event trace, as returned by schedtrace().
+
+#define SE_SWITCHIN   1  // pid starts running on cpu
+#define SE_SWITCHOUT  2  // pid stops running; arg is its new state
+#define SE_WAKEUP     3  // pid made RUNNABLE by wakeup(); arg is waker
+#define SE_SLEEP      4  // pid goes to sleep
+#define SE_FORK       5  // pid created; arg is parent
+#define SE_EXIT       6  // pid exits; arg is exit status
+
+struct schedevent {
+  uint64 time;  // r_time() when it happened
+  short type;   // SE_*
+  short cpu;    // hart that recorded it
+  int pid;
+  int arg;
+};
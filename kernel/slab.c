@@ -0,0 +1,167 @@
+// Slab allocator for small kernel objects, layered on kalloc().
+//
+// kalloc() hands out whole 4096-byte pages, which wastes most
+// of a page on objects like struct pipe (~550 bytes). A
+// kmem_cache instead carves each page into equal-sized objects
+// and keeps a free list per page, so many objects share a page.
+//
+// The slab header sits at the start of its page, so the owning
+// slab of any object is found with PGROUNDDOWN().
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "slab.h"
+#include "slabstat.h"
+#include "proc.h"
+#include "defs.h"
+
+#define NCACHE 8  // maximum number of registered caches
+
+#define SLABHDR ((sizeof(struct slab) + 15) & ~15)
+
+struct {
+  struct spinlock lock;
+  struct kmem_cache *cache[NCACHE];
+  int n;
+} slabtable;
+
+void
+slabinit(void)
+{
+  initlock(&slabtable.lock, "slabtable");
+}
+
+// Set up cache c for objects of size bytes.
+// size is rounded up to 16 bytes so objects stay aligned.
+void
+kmem_cache_init(struct kmem_cache *c, char *name, uint size)
+{
+  size = (size + 15) & ~15;
+  if(size == 0 || size > PGSIZE - SLABHDR)
+    panic("kmem_cache_init: size");
+
+  initlock(&c->lock, name);
+  c->name = name;
+  c->objsize = size;
+  c->perslab = (PGSIZE - SLABHDR) / size;
+  c->slabs = 0;
+  c->nslabs = 0;
+  c->active = 0;
+
+  acquire(&slabtable.lock);
+  if(slabtable.n >= NCACHE)
+    panic("kmem_cache_init: too many caches");
+  slabtable.cache[slabtable.n++] = c;
+  release(&slabtable.lock);
+}
+
+// Allocate a fresh slab page for c and thread its free list.
+// Caller must hold c->lock.
+static struct slab*
+slab_grow(struct kmem_cache *c)
+{
+  struct slab *s;
+  char *obj;
+  int i;
+
+  if((s = (struct slab*)kalloc()) == 0)
+    return 0;
+  s->cache = c;
+  s->inuse = 0;
+  s->freelist = 0;
+  obj = (char*)s + SLABHDR;
+  for(i = 0; i < c->perslab; i++, obj += c->objsize){
+    *(void**)obj = s->freelist;
+    s->freelist = obj;
+  }
+  s->next = c->slabs;
+  c->slabs = s;
+  c->nslabs++;
+  return s;
+}
+
+// Allocate one object from cache c.
+// Returns 0 if no memory is available.
+void*
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  acquire(&c->lock);
+  for(s = c->slabs; s; s = s->next)
+    if(s->freelist)
+      break;
+  if(s == 0 && (s = slab_grow(c)) == 0){
+    release(&c->lock);
+    return 0;
+  }
+  obj = s->freelist;
+  s->freelist = *(void**)obj;
+  s->inuse++;
+  c->active++;
+  release(&c->lock);
+  return obj;
+}
+
+// Return obj to cache c. An empty slab is handed back to
+// kalloc() unless it is the cache's only slab, which is kept
+// to avoid a page round-trip on alloc/free ping-pong.
+void
+kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+  struct slab *s, **pp;
+
+  s = (struct slab*)PGROUNDDOWN((uint64)obj);
+  if(s->cache != c)
+    panic("kmem_cache_free: wrong cache");
+
+  acquire(&c->lock);
+  *(void**)obj = s->freelist;
+  s->freelist = obj;
+  s->inuse--;
+  c->active--;
+  if(s->inuse == 0 && c->nslabs > 1){
+    for(pp = &c->slabs; *pp != s; pp = &(*pp)->next)
+      ;
+    *pp = s->next;
+    c->nslabs--;
+    release(&c->lock);
+    kfree((void*)s);
+    return;
+  }
+  release(&c->lock);
+}
+
+// Copy out the usage of up to n caches to addr, an array of
+// struct slabstat. Returns the number copied, or -1.
+int
+kmem_cache_stat(uint64 addr, int n)
+{
+  struct kmem_cache *c;
+  struct slabstat st;
+  int i;
+
+  for(i = 0; i < n; i++){
+    acquire(&slabtable.lock);
+    c = i < slabtable.n ? slabtable.cache[i] : 0;
+    release(&slabtable.lock);
+    if(c == 0)
+      break;
+    // caches are never unregistered, so c stays valid.
+    acquire(&c->lock);
+    safestrcpy(st.name, c->name, sizeof(st.name));
+    st.objsize = c->objsize;
+    st.perslab = c->perslab;
+    st.active = c->active;
+    st.nslabs = c->nslabs;
+    release(&c->lock);
+
+    // copy out with no locks held; it may fault.
+    if(copyout(myproc()->pagetable, addr + i*sizeof(st), (char*)&st, sizeof(st)) < 0)
+      return -1;
+  }
+  return i;
+}
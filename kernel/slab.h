@@ -0,0 +1,21 @@
+// Slab allocator for small, fixed-size kernel objects.
+
+// Header at the start of every slab page; the rest of the
+// page is carved into objects of the cache's size.
+struct slab {
+  struct slab *next;         // next slab in this cache
+  struct kmem_cache *cache;  // cache that owns this slab
+  void *freelist;            // free objects in this slab
+  uint inuse;                // number of allocated objects
+};
+
+// One cache per object type (e.g. struct pipe).
+struct kmem_cache {
+  struct spinlock lock;
+  char *name;                // Name of cache (for slabinfo).
+  uint objsize;              // Size of each object, rounded up.
+  uint perslab;              // Objects per slab page.
+  struct slab *slabs;        // All slabs owned by this cache.
+  uint nslabs;               // Number of slab pages held.
+  uint active;               // Objects currently allocated.
+};
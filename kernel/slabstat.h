@@ -0,0 +1,8 @@
+// Usage of one slab cache, as returned by slabinfo().
+struct slabstat {
+  char name[16];
+  uint objsize;       // bytes per object, rounded up
+  uint perslab;       // objects per slab page
+  uint active;        // objects allocated
+  uint nslabs;        // slab pages held
+};
@@ -6,10 +6,15 @@
 
 void main();
 void timerinit();
+void ipiinit();
+void ipivec();
 
 // entry.S needs one stack per CPU.
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 
+// scratch space for ipivec in kernelvec.S, two words per CPU.
+uint64 ipiscratch[NCPU][2];
+
 // entry.S jumps here in machine mode on stack0.
 void
 start()
@@ -30,7 +35,7 @@ start()
   // delegate all interrupts and exceptions to supervisor mode.
   w_medeleg(0xffff);
   w_mideleg(0xffff);
-  w_sie(r_sie() | SIE_SEIE | SIE_STIE);
+  w_sie(r_sie() | SIE_SEIE | SIE_STIE | SIE_SSIE);
 
   // configure Physical Memory Protection to give supervisor mode
   // access to all of physical memory.
@@ -40,6 +45,9 @@ start()
   // ask for clock interrupts.
   timerinit();
 
+  // let other harts wake this one.
+  ipiinit();
+
   // keep each CPU's hartid in its tp register, for cpuid().
   int id = r_mhartid();
   w_tp(id);
@@ -62,5 +70,17 @@ timerinit()
   w_mcounteren(r_mcounteren() | 2);
   
   // ask for the very first timer interrupt.
-  w_stimecmp(r_time() + 1000000);
+  w_stimecmp(r_time() + TICKCYCLES);
+}
+
+// machine-mode software interrupts can't be delegated;
+// ipivec turns them into supervisor software interrupts.
+void
+ipiinit()
+{
+  int id = r_mhartid();
+
+  w_mscratch((uint64)ipiscratch[id]);
+  w_mtvec((uint64)ipivec);
+  w_mie(r_mie() | MIE_MSIE);
 }
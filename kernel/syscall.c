@@ -111,6 +111,18 @@ extern uint64 sys_time(void);
 extern uint64 sys_nice(void);
 extern uint64 sys_freemem(void);
 extern uint64 sys_mmap(void);
+extern uint64 sys_slabinfo(void);
+extern uint64 sys_munmap(void);
+extern uint64 sys_schedstat(void);
+extern uint64 sys_setsched(void);
+extern uint64 sys_quantum(void);
+extern uint64 sys_wakestat(void);
+extern uint64 sys_procstat(void);
+extern uint64 sys_schedtrace(void);
+extern uint64 sys_setrt(void);
+extern uint64 sys_setaffinity(void);
+extern uint64 sys_getaffinity(void);
+extern uint64 sys_bcachestat(void);
 
 // An array mapping syscall numiers from syscall.h
 // to the function that handles the system call.
@@ -144,7 +156,19 @@ static uint64 (*syscalls[])(void) = {
 [SYS_time]    sys_time,
 [SYS_nice]    sys_nice,
 [SYS_freemem]    sys_freemem,
-[SYS_mmap]    sys_mmap
+[SYS_mmap]    sys_mmap,
+[SYS_slabinfo] sys_slabinfo,
+[SYS_munmap]  sys_munmap,
+[SYS_schedstat] sys_schedstat,
+[SYS_setsched] sys_setsched,
+[SYS_quantum] sys_quantum,
+[SYS_wakestat] sys_wakestat,
+[SYS_procstat] sys_procstat,
+[SYS_schedtrace] sys_schedtrace,
+[SYS_setrt]   sys_setrt,
+[SYS_setaffinity] sys_setaffinity,
+[SYS_getaffinity] sys_getaffinity,
+[SYS_bcachestat] sys_bcachestat
 };
 
 void
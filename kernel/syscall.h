@@ -29,3 +29,15 @@
 #define SYS_nice        28
 #define SYS_freemem     29
 #define SYS_mmap        30
+#define SYS_slabinfo    31
+#define SYS_munmap      32
+#define SYS_schedstat   33
+#define SYS_setsched    34
+#define SYS_quantum     35
+#define SYS_wakestat    36
+#define SYS_procstat    37
+#define SYS_schedtrace  38
+#define SYS_setrt       39
+#define SYS_setaffinity 40
+#define SYS_getaffinity 41
+#define SYS_bcachestat  42
@@ -222,6 +222,7 @@ sys_unlink(void)
   memset(&de, 0, sizeof(de));
   if(writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
     panic("unlink: writei");
+  dcacheenter(dp, name, 0, 0);
   if(ip->type == T_DIR){
     dp->nlink--;
     iupdate(dp);
@@ -341,6 +342,13 @@ sys_open(void)
     return -1;
   }
 
+  // a running program can't be truncated; see iexec().
+  if((omode & O_TRUNC) && ip->type == T_FILE && itextbusy(ip)){
+    iunlockput(ip);
+    end_op();
+    return -1;
+  }
+
   if((f = filealloc()) == 0 || (fd = fdalloc(f)) < 0){
     if(f)
       fileclose(f);
@@ -355,6 +363,9 @@ sys_open(void)
   } else {
     f->type = FD_INODE;
     f->off = 0;
+    f->ranext = 0;
+    f->rawin = 0;
+    f->raend = 0;
   }
   f->ip = ip;
   f->readable = !(omode & O_WRONLY);
@@ -504,44 +515,325 @@ sys_pipe(void)
   return 0;
 }
 
+// Memory-mapped files.
+//
+// Each process has NVMA regions, placed top-down below
+// TRAPFRAME, each in the highest gap it fits in, so that space
+// freed by munmap is used again (p->mmap is the lowest address
+// in use, or TRAPFRAME if none). Pages
+// are filled lazily by mmapfault(). Pages of a MAP_SHARED file
+// mapping are written back to the file when unmapped.
+
+// Find the region of p containing va.
+static struct vma*
+vmalookup(struct proc *p, uint64 va)
+{
+  for(int i = 0; i < NVMA; i++){
+    struct vma *v = &p->vma[i];
+    if(v->used && va >= v->start && va < v->start + v->len)
+      return v;
+  }
+  return 0;
+}
+
+// Find the highest free range of sz bytes below TRAPFRAME and
+// above the heap. Free ranges end at TRAPFRAME or at the start
+// of a region. Returns its start, or 0 if there is none.
+static uint64
+vmagap(struct proc *p, uint64 sz)
+{
+  uint64 top, start, best = 0;
+  int i, j;
+
+  for(i = -1; i < NVMA; i++){
+    if(i < 0)
+      top = TRAPFRAME;
+    else if(p->vma[i].used)
+      top = p->vma[i].start;
+    else
+      continue;
+    start = top - sz;
+    if(start > top || start < PGROUNDUP(p->sz) || start <= best)
+      continue;
+    for(j = 0; j < NVMA; j++){
+      struct vma *v = &p->vma[j];
+      if(v->used && start < v->start + v->len && v->start < top)
+        break;
+    }
+    if(j == NVMA)
+      best = start;
+  }
+  return best;
+}
+
+// Recompute p->mmap after the regions changed.
+static void
+vmalowest(struct proc *p)
+{
+  p->mmap = TRAPFRAME;
+  for(int i = 0; i < NVMA; i++)
+    if(p->vma[i].used && p->vma[i].start < p->mmap)
+      p->mmap = p->vma[i].start;
+}
+
+// Fill in the page containing va from its region.
+// Returns the physical address, or 0 if va isn't mapped
+// by any region or memory ran out.
 uint64
-sys_mmap(void)
+mmapfault(struct proc *p, uint64 va)
 {
-  struct proc *p = myproc();
-  uint64 va;
-  char *pa;
-  
-  va = p->mmap;
-  
-  // Debug 
-  printf("mmap: va = %ld, TRAPFRAME = %ld, USERSTACK = %d\n", va, TRAPFRAME, USERSTACK);
+  struct vma *v;
+  struct inode *ip;
+  char *mem;
+  int perm, locked;
 
-  // Check if va is page-aligned
-  if(va % PGSIZE != 0) {
-    printf("ERROR: va is not page-aligned!\n");
-    return -1;
+  va = PGROUNDDOWN(va);
+  if((v = vmalookup(p, va)) == 0 || ismapped(p->pagetable, va))
+    return 0;
+  // reading the file may sleep. A caller that copies to or
+  // from user memory under a spinlock (wait) must page the
+  // range in first with uvmprefault(); so do fileread() and
+  // filewrite(), for readi()'s and writei()'s buffer locks.
+  if(v->f && !cansleep())
+    return 0;
+
+  if((mem = kalloc_zeroed()) == 0)
+    return 0;
+  if(v->f){
+    ip = v->f->ip;
+    // write(fd, mapping of the same file, n) already holds ip->lock.
+    locked = holdingsleep(&ip->lock);
+    if(!locked)
+      ilock(ip);
+    readi(ip, 0, (uint64)mem, v->off + (va - v->start), PGSIZE);
+    if(!locked)
+      iunlock(ip);
   }
-  
-  // Allocate a physical page
-  pa = kalloc();
-  if(pa == 0)
+
+  perm = PTE_U | PTE_R;
+  if(v->prot & PROT_WRITE)
+    perm |= PTE_W;
+  if(v->prot & PROT_EXEC)
+    perm |= PTE_X;
+  if(mappages(p->pagetable, va, PGSIZE, (uint64)mem, perm) != 0){
+    kfree(mem);
+    return 0;
+  }
+  return (uint64)mem;
+}
+
+// Write back the faulted-in pages of region v in [va, va+len),
+// if it is a writable MAP_SHARED file mapping. Never extends
+// the file.
+static void
+vmawriteback(struct proc *p, struct vma *v, uint64 va, uint64 len)
+{
+  struct inode *ip;
+  uint64 a, pa;
+  uint off, i, n;
+  // as in filewrite(), a few blocks per transaction.
+  int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+
+  if(v->f == 0 || (v->flags & MAP_SHARED) == 0 || (v->prot & PROT_WRITE) == 0)
+    return;
+  ip = v->f->ip;
+  for(a = va; a < va + len; a += PGSIZE){
+    if((pa = walkaddr(p->pagetable, a)) == 0)
+      continue;
+    off = v->off + (a - v->start);
+    for(i = 0; i < PGSIZE; i += n){
+      n = PGSIZE - i;
+      if(n > max)
+        n = max;
+      begin_op();
+      ilock(ip);
+      if(off + i >= ip->size){
+        iunlock(ip);
+        end_op();
+        break;
+      }
+      if(off + i + n > ip->size)
+        n = ip->size - (off + i);
+      writei(ip, 0, pa + i, off + i, n);
+      iunlock(ip);
+      end_op();
+    }
+  }
+}
+
+// Remove [va, va+len) from region v, writing back and freeing
+// its pages. The range must be at the start or end of v.
+static void
+vmaunmap(struct proc *p, struct vma *v, uint64 va, uint64 len)
+{
+  vmawriteback(p, v, va, len);
+  uvmunmap(p->pagetable, va, len / PGSIZE, 1);
+  if(va == v->start){
+    v->start += len;
+    v->off += len;
+  }
+  v->len -= len;
+  if(v->len == 0){
+    if(v->f)
+      fileclose(v->f);
+    v->f = 0;
+    v->used = 0;
+  }
+  vmalowest(p);
+}
+
+// Unmap every region of p, as at exit or exec.
+void
+munmapall(struct proc *p)
+{
+  for(int i = 0; i < NVMA; i++)
+    if(p->vma[i].used)
+      vmaunmap(p, &p->vma[i], p->vma[i].start, p->vma[i].len);
+  p->mmap = TRAPFRAME;
+}
+
+// Give child np a copy of p's regions.
+// MAP_SHARED pages are faulted in and then shared, so both
+// processes see each other's writes; MAP_PRIVATE pages that
+// are present are copied. Returns 0, or -1 with nothing in np
+// left to clean up.
+int
+mmapcopy(struct proc *p, struct proc *np)
+{
+  struct vma *v;
+  uint64 a, pa;
+  char *mem;
+  pte_t *pte;
+  int i;
+
+  for(i = 0; i < NVMA; i++){
+    v = &p->vma[i];
+    if(!v->used)
+      continue;
+    for(a = v->start; a < v->start + v->len; a += PGSIZE){
+      pa = walkaddr(p->pagetable, a);
+      if(pa == 0 && (v->flags & MAP_SHARED))
+        pa = mmapfault(p, a);
+      if(pa == 0)
+        continue;
+      pte = walk(p->pagetable, a, 0);
+      if(v->flags & MAP_SHARED){
+        if(mappages(np->pagetable, a, PGSIZE, pa, PTE_FLAGS(*pte)) != 0)
+          goto bad;
+        krefpage((void*)pa);
+      } else {
+        if((mem = kalloc()) == 0)
+          goto bad;
+        memmove(mem, (char*)pa, PGSIZE);
+        if(mappages(np->pagetable, a, PGSIZE, (uint64)mem, PTE_FLAGS(*pte)) != 0){
+          kfree(mem);
+          goto bad;
+        }
+      }
+    }
+    np->vma[i] = *v;
+    if(v->f)
+      filedup(v->f);
+  }
+  np->mmap = p->mmap;
+  return 0;
+
+ bad:
+  // regions 0..i-1 were copied; region i is partly mapped.
+  for(int j = 0; j <= i; j++){
+    v = &p->vma[j];
+    if(!v->used)
+      continue;
+    uvmunmap(np->pagetable, v->start, v->len / PGSIZE, 1);
+    if(j < i && v->f)
+      fileclose(v->f);
+    np->vma[j].used = 0;
+    np->vma[j].f = 0;
+  }
+  return -1;
+}
+
+// void *mmap(void *addr, int len, int prot, int flags, int fd, int off)
+// addr is only a hint and is ignored; the region goes in the
+// highest free range that fits (see vmagap()).
+uint64
+sys_mmap(void)
+{
+  struct proc *p = myproc();
+  struct file *f = 0;
+  struct vma *v = 0;
+  uint64 addr;
+  int len, prot, flags, off;
+
+  argaddr(0, &addr);
+  argint(1, &len);
+  argint(2, &prot);
+  argint(3, &flags);
+  argint(5, &off);
+
+  if(len <= 0 || off < 0 || off % PGSIZE != 0)
     return -1;
-  
-  memset(pa, 0, PGSIZE);
-  
-  // Map the page into the process's address space
-  if(mappages(p->pagetable, va, PGSIZE, (uint64)pa, PTE_R | PTE_W | PTE_U) != 0) {
-    kfree(pa);
+  if(((flags & MAP_SHARED) != 0) == ((flags & MAP_PRIVATE) != 0))
     return -1;
+  if((flags & MAP_ANONYMOUS) == 0){
+    if(argfd(4, 0, &f) < 0 || f->type != FD_INODE)
+      return -1;
+    if((prot & PROT_READ) && !f->readable)
+      return -1;
+    if((prot & PROT_WRITE) && (flags & MAP_SHARED) &&
+       (!f->writable || itextbusy(f->ip)))
+      return -1;
   }
-  
-  // Verify the mapping worked
-  if(walkaddr(p->pagetable, va) != (uint64)pa) {
-    panic("invalid mmap");
+
+  for(int i = 0; i < NVMA; i++){
+    if(p->vma[i].used == 0){
+      v = &p->vma[i];
+      break;
+    }
   }
-  
-  p->mmap -= PGSIZE;
-  p->has_mmap = 1;
-  
-  return va;
+  if(v == 0)
+    return -1;
+
+  uint64 sz = PGROUNDUP((uint64)len);
+  uint64 start = vmagap(p, sz);
+  if(start == 0)
+    return -1;
+
+  v->used = 1;
+  v->start = start;
+  v->len = sz;
+  v->prot = prot;
+  v->flags = flags;
+  v->off = off;
+  v->f = f ? filedup(f) : 0;
+  vmalowest(p);
+
+  return v->start;
+}
+
+// int munmap(void *addr, int len)
+// Unmaps whole pages at the start or end of one region.
+uint64
+sys_munmap(void)
+{
+  struct proc *p = myproc();
+  struct vma *v;
+  uint64 addr;
+  int len;
+
+  argaddr(0, &addr);
+  argint(1, &len);
+
+  if(addr % PGSIZE != 0 || len <= 0)
+    return -1;
+  if((v = vmalookup(p, addr)) == 0)
+    return -1;
+  uint64 sz = PGROUNDUP((uint64)len);
+  if(addr + sz > v->start + v->len)
+    return -1;
+  if(addr != v->start && addr + sz != v->start + v->len)
+    return -1;  // would punch a hole
+
+  vmaunmap(p, v, addr, sz);
+  return 0;
 }
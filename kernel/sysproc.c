@@ -5,7 +5,9 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
 #include "vm.h"
+#include "iostat.h"
 
 uint64
 sys_exit(void)
@@ -60,6 +62,10 @@ sys_sbrk(void)
   argint(1, &t);
   addr = myproc()->sz;
 
+  // the heap must not grow into the mmap regions.
+  if(n > 0 && addr + n > myproc()->mmap)
+    return -1;
+
   if(t == SBRK_EAGER || n < 0) {
     if(growproc(n) < 0) {
       return -1;
@@ -91,6 +97,7 @@ sys_pause(void)
       release(&tickslock);
       return -1;
     }
+    tickdeadline(ticks0 + n);
     sleep(&ticks, &tickslock);
   }
   release(&tickslock);
@@ -113,6 +120,7 @@ sys_uptime(void)
 {
   uint xticks;
 
+  tickupdate();
   acquire(&tickslock);
   xticks = ticks;
   release(&tickslock);
@@ -175,18 +183,161 @@ sys_nice(void)
   if(n < 0) n = 0;
   if(n > 3) n = 3;
   
-  struct proc *p = myproc();
-  
-  acquire(&p->lock);
-  p->nice_lv = n;  // Also check: is it nice_lv or nice_level?
-  p->priority = 3 - n;
-  release(&p->lock);
+  setnice(myproc(), n);
   
   return 0;
 }
 
+uint64
+sys_setsched(void)
+{
+  int c;
+
+  argint(0, &c);
+  if(c != SCHED_MLFQ && c != SCHED_STRIDE)
+    return -1;
+  setsched(myproc(), c);
+  return 0;
+}
+
+// setrt(budget, period): make the caller real-time, allowed
+// to run budget ticks out of every period ticks. budget must
+// be less than period, so other processes on the hart still
+// get some of every period.
+uint64
+sys_setrt(void)
+{
+  int budget, period;
+
+  argint(0, &budget);
+  argint(1, &period);
+  if(budget <= 0 || budget >= period)
+    return -1;
+  setrt(myproc(), budget, period);
+  return 0;
+}
+
+// setaffinity(pid, mask): let process pid (0 for the caller)
+// run only on the harts whose bits are set in mask.
+uint64
+sys_setaffinity(void)
+{
+  int pid, mask;
+
+  argint(0, &pid);
+  argint(1, &mask);
+  return setaffinity(pid, (uint)mask);
+}
+
+// getaffinity(pid): the hart mask of process pid.
+uint64
+sys_getaffinity(void)
+{
+  int pid;
+
+  argint(0, &pid);
+  return getaffinity(pid);
+}
+
+// quantum(pri, n): set the quantum of priority pri to n
+// ticks (n <= 0 only queries). Returns the old value.
+uint64
+sys_quantum(void)
+{
+  int pri, n;
+
+  argint(0, &pri);
+  argint(1, &n);
+  return setquantum(pri, n);
+}
+
+// procstat(buf, n): copy out accounting for up to n
+// processes. Returns the number copied.
+uint64
+sys_procstat(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return procstat(addr, n);
+}
+
+// schedtrace(buf, n): drain up to n scheduler events.
+// Returns the number copied.
+uint64
+sys_schedtrace(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return schedtracecopy(myproc()->pagetable, addr, n);
+}
+
+// wakestat(st): copy out the wakeup() counters
+// (calls, sleepers examined, sleepers woken).
+uint64
+sys_wakestat(void)
+{
+  uint64 addr;
+  uint64 st[3];
+
+  argaddr(0, &addr);
+  wakestat(st);
+  if(copyout(myproc()->pagetable, addr, (char*)st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
+
 uint64
 sys_freemem(void)
 {
 	return freemem();
 }
+
+// slabinfo(buf, n): copy out the usage of up to n slab
+// caches. Returns the number copied.
+uint64
+sys_slabinfo(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return kmem_cache_stat(addr, n);
+}
+
+// bcachestat(st): copy out the buffer cache, disk, log and
+// name cache counters.
+uint64
+sys_bcachestat(void)
+{
+  uint64 addr;
+  struct iostat st;
+
+  argaddr(0, &addr);
+  bcachestat(&st.bcache);
+  virtio_disk_stat(&st.disk);
+  logstat(&st.log);
+  dcachestat(&st.dcache);
+  if(copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st)) < 0)
+    return -1;
+  return 0;
+}
+
+// schedstat(buf, n): copy out the run queue counters of up
+// to n harts. Returns the number copied.
+uint64
+sys_schedstat(void)
+{
+  uint64 addr;
+  int n;
+
+  argaddr(0, &addr);
+  argint(1, &n);
+  return runqstat(addr, n);
+}
@@ -9,6 +9,14 @@
 struct spinlock tickslock;
 uint ticks;
 
+// ticks is derived from the time CSR, so any hart's timer
+// interrupt can advance it and idle harts need not take one
+// every tick. The earliest tick a pause() is waiting for
+// tells idle harts how long they may sleep.
+static uint64 tickbase;   // time CSR at boot
+static uint deadline;     // earliest tick a sleeper waits for
+static int hasdeadline;
+
 extern char trampoline[], uservec[];
 
 // in kernelvec.S, calls kerneltrap().
@@ -20,6 +28,7 @@ void
 trapinit(void)
 {
   initlock(&tickslock, "time");
+  tickbase = r_time();
 }
 
 // set up to take exceptions and traps while in the kernel.
@@ -68,9 +77,11 @@ usertrap(void)
     syscall();
   } else if((which_dev = devintr()) != 0){
     // ok
-  } else if((r_scause() == 15 || r_scause() == 13) &&
-            vmfault(p->pagetable, r_stval(), (r_scause() == 13)? 1 : 0) != 0) {
-    // page fault on lazily-allocated page
+  } else if((r_scause() == 15 || r_scause() == 13 || r_scause() == 12) &&
+            vmfault(p->pagetable, r_stval(), (r_scause() != 15)? 1 : 0) != 0) {
+    // page fault on lazily-allocated page; an instruction
+    // fetch (12) pages in program text like a load (13).
+    p->nfaults++;
   } else {
     printf("usertrap(): unexpected scause 0x%lx pid=%d\n", r_scause(), p->pid);
     printf("            sepc=0x%lx stval=0x%lx\n", r_sepc(), r_stval());
@@ -80,9 +91,11 @@ usertrap(void)
   if(killed(p))
     kexit(-1);
 
-  // give up the CPU if this is a timer interrupt.
+  // give up the CPU if this timer interrupt ends the
+  // process's quantum.
   if(which_dev == 2)
-    yield();
+    preempt();
+  rtpreempt();
 
   prepare_return();
 
@@ -151,30 +164,75 @@ kerneltrap()
     panic("kerneltrap");
   }
 
-  // give up the CPU if this is a timer interrupt.
+  // give up the CPU if this timer interrupt ends the
+  // process's quantum.
   if(which_dev == 2 && myproc() != 0)
-    yield();
+    preempt();
+  if(myproc() != 0)
+    rtpreempt();
 
-  // the yield() may have caused some traps to occur,
+  // the preempt() may have caused some traps to occur,
   // so restore trap registers for use by kernelvec.S's sepc instruction.
   w_sepc(sepc);
   w_sstatus(sstatus);
 }
 
+// Bring ticks up to date with the time CSR and wake
+// sleepers if it moved.
 void
-clockintr()
+tickupdate(void)
 {
-  if(cpuid() == 0){
-    acquire(&tickslock);
-    ticks++;
+  uint now = (r_time() - tickbase) / TICKCYCLES;
+
+  if(now == ticks)
+    return;
+  acquire(&tickslock);
+  if((int)(now - ticks) > 0){
+    ticks = now;
+    if(hasdeadline && (int)(ticks - deadline) >= 0)
+      hasdeadline = 0;
     wakeup(&ticks);
-    release(&tickslock);
   }
+  release(&tickslock);
+}
+
+// Note that a sleeper on &ticks wants to run again at tick t.
+// Caller must hold tickslock.
+void
+tickdeadline(uint t)
+{
+  if(!hasdeadline || (int)(t - deadline) < 0){
+    deadline = t;
+    hasdeadline = 1;
+  }
+}
+
+// Program this hart's timer for an idle sleep: until the
+// next pause() deadline, but at most IDLETICKS.
+void
+tickidle(void)
+{
+  uint64 when = r_time() + IDLETICKS * TICKCYCLES;
+  uint64 t;
+
+  acquire(&tickslock);
+  if(hasdeadline){
+    t = tickbase + (uint64)deadline * TICKCYCLES;
+    if(t < when)
+      when = t;
+  }
+  release(&tickslock);
+  w_stimecmp(when);
+}
+
+void
+clockintr()
+{
+  tickupdate();
 
   // ask for the next timer interrupt. this also clears
-  // the interrupt request. 1000000 is about a tenth
-  // of a second.
-  w_stimecmp(r_time() + 1000000);
+  // the interrupt request.
+  w_stimecmp(r_time() + TICKCYCLES);
 }
 
 // check if it's an external interrupt or software interrupt,
@@ -212,6 +270,13 @@ devintr()
     // timer interrupt.
     clockintr();
     return 2;
+  } else if(scause == 0x8000000000000001L){
+    // software interrupt from another hart's wakehart(),
+    // via ipivec. there is nothing to do but acknowledge it;
+    // the point was to end this hart's wfi, or to get it to
+    // call rtpreempt() on the way out of this trap.
+    w_sip(r_sip() & ~2);
+    return 1;
   } else {
     return 0;
   }
@@ -15,6 +15,7 @@
 #include "fs.h"
 #include "buf.h"
 #include "virtio.h"
+#include "iostat.h"
 
 // the address of virtio mmio register r.
 #define R(r) ((volatile uint32 *)(VIRTIO0 + (r)))
@@ -53,6 +54,10 @@ static struct disk {
   // disk command headers.
   // one-for-one with descriptors, for convenience.
   struct virtio_blk_req ops[NUM];
+
+  // requests and blocks queued, and how many are in flight.
+  uint64 nread, nwrite, nblocks;
+  int inflight, maxinflight;
   
   struct spinlock vdisk_lock;
   
@@ -196,12 +201,11 @@ free_chain(int i)
   }
 }
 
-// allocate three descriptors (they need not be contiguous).
-// disk transfers always use three descriptors.
+// allocate n descriptors (they need not be contiguous).
 static int
-alloc3_desc(int *idx)
+alloc_descs(int *idx, int n)
 {
-  for(int i = 0; i < 3; i++){
+  for(int i = 0; i < n; i++){
     idx[i] = alloc_desc();
     if(idx[i] < 0){
       for(int j = 0; j < i; j++)
@@ -212,27 +216,18 @@ alloc3_desc(int *idx)
   return 0;
 }
 
-void
-virtio_disk_rw(struct buf *b, int write)
+// Fill in the descriptors idx[] for a transfer of the nb
+// consecutive blocks in the list of bufs at b, and add it to
+// the avail ring. The device starts on it at the next
+// notify(). Caller must hold vdisk_lock.
+static void
+queue(struct buf *b, int nb, int write, int *idx)
 {
   uint64 sector = b->blockno * (BSIZE / 512);
+  struct buf *bp;
+  int i;
 
-  acquire(&disk.vdisk_lock);
-
-  // the spec's Section 5.2 says that legacy block operations use
-  // three descriptors: one for type/reserved/sector, one for the
-  // data, one for a 1-byte status result.
-
-  // allocate the three descriptors.
-  int idx[3];
-  while(1){
-    if(alloc3_desc(idx) == 0) {
-      break;
-    }
-    sleep(&disk.free[0], &disk.vdisk_lock);
-  }
-
-  // format the three descriptors.
+  // format the descriptors.
   // qemu's virtio-blk.c reads them.
 
   struct virtio_blk_req *buf0 = &disk.ops[idx[0]];
@@ -249,23 +244,26 @@ virtio_disk_rw(struct buf *b, int write)
   disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
   disk.desc[idx[0]].next = idx[1];
 
-  disk.desc[idx[1]].addr = (uint64) b->data;
-  disk.desc[idx[1]].len = BSIZE;
-  if(write)
-    disk.desc[idx[1]].flags = 0; // device reads b->data
-  else
-    disk.desc[idx[1]].flags = VRING_DESC_F_WRITE; // device writes b->data
-  disk.desc[idx[1]].flags |= VRING_DESC_F_NEXT;
-  disk.desc[idx[1]].next = idx[2];
+  // one descriptor per block, gathered into one transfer.
+  for(i = 1, bp = b; i <= nb; i++, bp = bp->ionext){
+    disk.desc[idx[i]].addr = (uint64) bp->data;
+    disk.desc[idx[i]].len = BSIZE;
+    if(write)
+      disk.desc[idx[i]].flags = 0; // device reads bp->data
+    else
+      disk.desc[idx[i]].flags = VRING_DESC_F_WRITE; // device writes bp->data
+    disk.desc[idx[i]].flags |= VRING_DESC_F_NEXT;
+    disk.desc[idx[i]].next = idx[i+1];
+    bp->disk = 1;
+  }
 
   disk.info[idx[0]].status = 0xff; // device writes 0 on success
-  disk.desc[idx[2]].addr = (uint64) &disk.info[idx[0]].status;
-  disk.desc[idx[2]].len = 1;
-  disk.desc[idx[2]].flags = VRING_DESC_F_WRITE; // device writes the status
-  disk.desc[idx[2]].next = 0;
+  disk.desc[idx[nb+1]].addr = (uint64) &disk.info[idx[0]].status;
+  disk.desc[idx[nb+1]].len = 1;
+  disk.desc[idx[nb+1]].flags = VRING_DESC_F_WRITE; // device writes the status
+  disk.desc[idx[nb+1]].next = 0;
 
   // record struct buf for virtio_disk_intr().
-  b->disk = 1;
   disk.info[idx[0]].b = b;
 
   // tell the device the first index in our chain of descriptors.
@@ -276,18 +274,98 @@ virtio_disk_rw(struct buf *b, int write)
   // tell the device another avail ring entry is available.
   disk.avail->idx += 1; // not % NUM ...
 
+  if(write)
+    disk.nwrite++;
+  else
+    disk.nread++;
+  disk.nblocks += nb;
+  if(++disk.inflight > disk.maxinflight)
+    disk.maxinflight = disk.inflight;
+}
+
+// Tell the device to look at the avail ring.
+static void
+notify(void)
+{
   __sync_synchronize();
 
   *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
+}
 
-  // Wait for virtio_disk_intr() to say request has finished.
+// Start n requests and return without waiting for them. Each
+// reqs[i] heads a list, through ionext, of locked bufs for
+// consecutive blocks, at most NUM-2 of them, to be read (or
+// written) in one transfer. When a request is over,
+// virtio_disk_intr() calls b->done(b) for each of its bufs
+// that has it set, and wakes up virtio_disk_wait(b) for the
+// others. If there are too few descriptors free, sleep for
+// more, or with nowait stop early. Returns how many requests
+// were started.
+int
+virtio_disk_submit(struct buf **reqs, int n, int write, int nowait)
+{
+  int idx[NUM];
+  struct buf *b;
+  int i, nb;
+
+  acquire(&disk.vdisk_lock);
+
+  // the spec's Section 5.2 says that legacy block operations use
+  // a descriptor for type/reserved/sector, then the data, then
+  // one for a 1-byte status result.
+
+  for(i = 0; i < n; i++){
+    for(nb = 0, b = reqs[i]; b; b = b->ionext)
+      nb++;
+    if(nb + 2 > NUM)
+      panic("virtio_disk_submit");
+    while(alloc_descs(idx, nb + 2) != 0){
+      if(nowait)
+        goto out;
+      // let the device start on what is queued so far.
+      notify();
+      sleep(&disk.free[0], &disk.vdisk_lock);
+    }
+    queue(reqs[i], nb, write, idx);
+  }
+out:
+  if(i > 0)
+    notify();
+  release(&disk.vdisk_lock);
+  return i;
+}
+
+// Wait for virtio_disk_intr() to say the transfer of b,
+// started without a done callback, has finished.
+void
+virtio_disk_wait(struct buf *b)
+{
+  acquire(&disk.vdisk_lock);
   while(b->disk == 1) {
     sleep(b, &disk.vdisk_lock);
   }
+  release(&disk.vdisk_lock);
+}
 
-  disk.info[idx[0]].b = 0;
-  free_chain(idx[0]);
+void
+virtio_disk_rw(struct buf *b, int write)
+{
+  b->ionext = 0;
+  virtio_disk_submit(&b, 1, write, 0);
+  virtio_disk_wait(b);
+}
 
+// Fill in how many requests the disk has served, and the
+// most that were in flight at once.
+void
+virtio_disk_stat(struct diskstat *st)
+{
+  acquire(&disk.vdisk_lock);
+  st->nread = disk.nread;
+  st->nwrite = disk.nwrite;
+  st->nblocks = disk.nblocks;
+  st->inflight = disk.inflight;
+  st->maxinflight = disk.maxinflight;
   release(&disk.vdisk_lock);
 }
 
@@ -316,9 +394,19 @@ virtio_disk_intr()
     if(disk.info[id].status != 0)
       panic("virtio_disk_intr status");
 
-    struct buf *b = disk.info[id].b;
-    b->disk = 0;   // disk is done with buf
-    wakeup(b);
+    struct buf *b = disk.info[id].b, *next;
+    disk.info[id].b = 0;
+    free_chain(id);
+    disk.inflight--;
+
+    for(; b; b = next){
+      next = b->ionext;  // b->done() may give b away
+      b->disk = 0;   // disk is done with buf
+      if(b->done)
+        b->done(b);
+      else
+        wakeup(b);
+    }
 
     disk.used_idx += 1;
   }
@@ -35,6 +35,9 @@ kvmmake(void)
   // PLIC
   kvmmap(kpgtbl, PLIC, PLIC, 0x4000000, PTE_R | PTE_W);
 
+  // CLINT msip registers, for wakehart()
+  kvmmap(kpgtbl, CLINT, CLINT, PGSIZE, PTE_R | PTE_W);
+
   // map kernel text executable and read-only.
   kvmmap(kpgtbl, KERNBASE, KERNBASE, (uint64)etext-KERNBASE, PTE_R | PTE_X);
 
@@ -88,6 +91,24 @@ kvminithart()
   sfence_vma();
 }
 
+// Split the 2MB megapage leaf *pte into 512 4KB leaves in a
+// new level-0 page table, keeping the same permissions.
+// Returns 0 on success, -1 if out of memory.
+static int
+demote(pte_t *pte)
+{
+  pagetable_t pt;
+  uint64 pa = PTE2PA(*pte);
+  int flags = PTE_FLAGS(*pte) & ~PTE_SUPER;
+
+  if((pt = (pagetable_t)kalloc_zeroed()) == 0)
+    return -1;
+  for(int i = 0; i < 512; i++)
+    pt[i] = PA2PTE(pa + i*PGSIZE) | flags;
+  *pte = PA2PTE(pt) | PTE_V;
+  return 0;
+}
+
 // Return the address of the PTE in page table pagetable
 // that corresponds to virtual address va.  If alloc!=0,
 // create any required page-table pages.
@@ -100,6 +121,10 @@ kvminithart()
 //   21..29 -- 9 bits of level-1 index.
 //   12..20 -- 9 bits of level-0 index.
 //    0..11 -- 12 bits of byte offset within the page.
+//
+// If va lies in a 2MB megapage, walk() returns the level-1
+// leaf PTE (marked PTE_SUPER) when alloc==0, and otherwise
+// demotes the megapage to 4KB pages first.
 pte_t *
 walk(pagetable_t pagetable, uint64 va, int alloc)
 {
@@ -108,12 +133,17 @@ walk(pagetable_t pagetable, uint64 va, int alloc)
 
   for(int level = 2; level > 0; level--) {
     pte_t *pte = &pagetable[PX(level, va)];
+    if(*pte & PTE_SUPER) {
+      if(!alloc)
+        return pte;
+      if(demote(pte) != 0)
+        return 0;
+    }
     if(*pte & PTE_V) {
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
-      if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
+      if(!alloc || (pagetable = (pde_t*)kalloc_zeroed()) == 0)
         return 0;
-      memset(pagetable, 0, PGSIZE);
       *pte = PA2PTE(pagetable) | PTE_V;
     }
   }
@@ -140,6 +170,8 @@ walkaddr(pagetable_t pagetable, uint64 va)
   if((*pte & PTE_U) == 0)
     return 0;
   pa = PTE2PA(*pte);
+  if(*pte & PTE_SUPER)
+    pa += PGROUNDDOWN(va) & (SUPERPGSIZE-1);
   return pa;
 }
 
@@ -179,6 +211,61 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
   return 0;
 }
 
+// Can va, which must be 2MB-aligned, be mapped with a megapage?
+// True if no 4KB page in [va, va+2MB) is mapped.
+static int
+superok(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  pagetable_t l0;
+
+  if(va + SUPERPGSIZE > MAXVA)
+    return 0;
+  pte = &pagetable[PX(2, va)];
+  if((*pte & PTE_V) == 0)
+    return 1;
+  pte = &((pagetable_t)PTE2PA(*pte))[PX(1, va)];
+  if((*pte & PTE_V) == 0)
+    return 1;
+  if(*pte & PTE_SUPER)
+    return 0;
+  l0 = (pagetable_t)PTE2PA(*pte);
+  for(int i = 0; i < 512; i++)
+    if(l0[i] & PTE_V)
+      return 0;
+  return 1;
+}
+
+// Map the 2MB megapage at physical address pa at va.
+// Both must be 2MB-aligned. Returns -1 if part of the range is
+// already mapped or a page-table page can't be allocated,
+// so the caller can fall back to 4KB pages.
+int
+mapsuper(pagetable_t pagetable, uint64 va, uint64 pa, int perm)
+{
+  pte_t *pte;
+
+  if((va % SUPERPGSIZE) != 0 || (pa % SUPERPGSIZE) != 0)
+    panic("mapsuper: not aligned");
+  if(!superok(pagetable, va))
+    return -1;
+
+  pte = &pagetable[PX(2, va)];
+  if((*pte & PTE_V) == 0){
+    pagetable_t l1 = (pagetable_t)kalloc_zeroed();
+    if(l1 == 0)
+      return -1;
+    *pte = PA2PTE(l1) | PTE_V;
+  }
+  pte = &((pagetable_t)PTE2PA(*pte))[PX(1, va)];
+  if(*pte & PTE_V){
+    // an empty level-0 table left behind by uvmunmap().
+    kfree((void*)PTE2PA(*pte));
+  }
+  *pte = PA2PTE(pa) | perm | PTE_V | PTE_SUPER;
+  return 0;
+}
+
 // create an empty user page table.
 // returns 0 if out of memory.
 pagetable_t
@@ -207,6 +294,19 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
   for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
     if((pte = walk(pagetable, a, 0)) == 0) // leaf page table entry allocated?
       continue;   
+    if(*pte & PTE_SUPER){
+      if(a % SUPERPGSIZE == 0 && a + SUPERPGSIZE <= va + npages*PGSIZE){
+        // the whole megapage goes.
+        if(do_free)
+          superfree((void*)PTE2PA(*pte));
+        *pte = 0;
+        a += SUPERPGSIZE - PGSIZE;
+        continue;
+      }
+      // partially unmapped: split it into 4KB pages.
+      if((pte = walk(pagetable, a, 1)) == 0)
+        panic("uvmunmap: demote");
+    }
     if((*pte & PTE_V) == 0)  // has physical page been allocated?
       continue;
     if(do_free){
@@ -219,6 +319,8 @@ uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 
 // Allocate PTEs and physical memory to grow a process from oldsz to
 // newsz, which need not be page aligned.  Returns new size or 0 on error.
+// 2MB-aligned stretches that the range fully covers get megapages
+// while any are left.
 uint64
 uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
 {
@@ -230,12 +332,20 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
 
   oldsz = PGROUNDUP(oldsz);
   for(a = oldsz; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    if(a % SUPERPGSIZE == 0 && a + SUPERPGSIZE <= newsz &&
+       superok(pagetable, a) && (mem = superalloc()) != 0){
+      if(mapsuper(pagetable, a, (uint64)mem, PTE_R|PTE_U|xperm) == 0){
+        memset(mem, 0, SUPERPGSIZE);
+        a += SUPERPGSIZE - PGSIZE;
+        continue;
+      }
+      superfree(mem);
+    }
+    mem = kalloc_zeroed();
     if(mem == 0){
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
     if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_R|PTE_U|xperm) != 0){
       kfree(mem);
       uvmdealloc(pagetable, a, oldsz);
@@ -314,6 +424,29 @@ uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
       continue;   // physical page hasn't been allocated
     pa = PTE2PA(*pte);
     flags = PTE_FLAGS(*pte);
+    if(*pte & PTE_SUPER){
+      flags &= ~PTE_SUPER;
+      if((mem = superalloc()) != 0){
+        if(mapsuper(new, i, (uint64)mem, flags) == 0){
+          memmove(mem, (char*)pa, SUPERPGSIZE);
+          i += SUPERPGSIZE - PGSIZE;
+          continue;
+        }
+        superfree(mem);
+      }
+      // no megapage left: copy it as 4KB pages.
+      for(uint64 end = i + SUPERPGSIZE; i < end; i += PGSIZE, pa += PGSIZE){
+        if((mem = kalloc()) == 0)
+          goto err;
+        memmove(mem, (char*)pa, PGSIZE);
+        if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0){
+          kfree(mem);
+          goto err;
+        }
+      }
+      i -= PGSIZE;
+      continue;
+    }
     if((mem = kalloc()) == 0)
       goto err;
     memmove(mem, (char*)pa, PGSIZE);
@@ -337,6 +470,8 @@ uvmclear(pagetable_t pagetable, uint64 va)
   pte_t *pte;
   
   pte = walk(pagetable, va, 0);
+  if(pte && (*pte & PTE_SUPER))
+    pte = walk(pagetable, va, 1);
   if(pte == 0)
     panic("uvmclear");
   *pte &= ~PTE_U;
@@ -421,8 +556,11 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
   while(got_null == 0 && max > 0){
     va0 = PGROUNDDOWN(srcva);
     pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
-      return -1;
+    if(pa0 == 0) {
+      // e.g. a string literal in a not-yet-paged-in text segment.
+      if((pa0 = vmfault(pagetable, va0, 0)) == 0)
+        return -1;
+    }
     n = PGSIZE - (srcva - va0);
     if(n > max)
       n = max;
@@ -452,7 +590,9 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 }
 
 // allocate and map user memory if process is referencing a page
-// that was lazily allocated in sys_sbrk().
+// that was lazily allocated in sys_sbrk(). a fault in a 2MB-aligned
+// stretch that lies entirely below p->sz and is still unmapped
+// maps a whole megapage, if one is free.
 // returns 0 if va is invalid or already mapped, or if
 // out of physical memory, and physical address if successful.
 uint64
@@ -462,15 +602,26 @@ vmfault(pagetable_t pagetable, uint64 va, int read)
   struct proc *p = myproc();
 
   if (va >= p->sz)
-    return 0;
+    return mmapfault(p, va);
   va = PGROUNDDOWN(va);
   if(ismapped(pagetable, va)) {
     return 0;
   }
-  mem = (uint64) kalloc();
+  if(inexec(p, va, PGSIZE))
+    return execfault(p, va);
+  uint64 sva = SUPERPGROUNDDOWN(va);
+  if(sva + SUPERPGSIZE <= p->sz && superok(p->pagetable, sva) &&
+     !inexec(p, sva, SUPERPGSIZE) &&
+     (mem = (uint64) superalloc()) != 0){
+    if(mapsuper(p->pagetable, sva, mem, PTE_W|PTE_U|PTE_R) == 0){
+      memset((void *) mem, 0, SUPERPGSIZE);
+      return mem + (va - sva);
+    }
+    superfree((void *) mem);
+  }
+  mem = (uint64) kalloc_zeroed();
   if(mem == 0)
     return 0;
-  memset((void *) mem, 0, PGSIZE);
   if (mappages(p->pagetable, va, PGSIZE, mem, PTE_W|PTE_U|PTE_R) != 0) {
     kfree((void *)mem);
     return 0;
@@ -478,6 +629,28 @@ vmfault(pagetable_t pagetable, uint64 va, int read)
   return mem;
 }
 
+// Page in the file-backed pages of [va, va+len) in p: program
+// segments and file mappings. readi() and writei() hold the
+// buffer of a file block while they copy to or from user
+// memory; were that memory an unpopulated page of the same
+// file, paging it in would bread() the same block again and
+// sleep on the buffer forever. Other pages fault as usual,
+// and failures are left for the copy to report.
+void
+uvmprefault(struct proc *p, uint64 va, uint64 len)
+{
+  uint64 a;
+
+  if(va >= MAXVA || len > MAXVA - va)
+    return;
+  for(a = PGROUNDDOWN(va); a < va + len; a += PGSIZE){
+    if(ismapped(p->pagetable, a))
+      continue;
+    if(a >= p->sz || inexec(p, a, PGSIZE))
+      vmfault(p->pagetable, a, 1);
+  }
+}
+
 int
 ismapped(pagetable_t pagetable, uint64 va)
 {
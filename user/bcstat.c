@@ -0,0 +1,50 @@
+#include "kernel/types.h"
+#include "kernel/fs.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+// Print the buffer cache's size and hit/miss counters, the
+// disk's request counts, the log's commit counts and the
+// name cache's hits, after running a command if one is given:
+// bcstat cat README.md
+
+struct iostat st;
+
+int
+main(int argc, char *argv[])
+{
+  if(argc > 1){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "bcstat: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      exec(argv[1], &argv[1]);
+      fprintf(2, "bcstat: exec %s failed\n", argv[1]);
+      exit(1);
+    }
+    wait(0);
+  }
+  if(bcachestat(&st) < 0){
+    fprintf(2, "bcstat: bcachestat failed\n");
+    exit(1);
+  }
+  printf("buffers %d (%d KB), cold %d, hot %d\n", st.bcache.nbuf,
+         st.bcache.nbuf * BSIZE / 1024, st.bcache.cold,
+         st.bcache.nbuf - st.bcache.cold);
+  printf("hits %lu misses %lu promoted %lu recycled %lu\n",
+         st.bcache.hits, st.bcache.misses, st.bcache.promotions,
+         st.bcache.recycled);
+  printf("read ahead %lu, used %lu\n", st.bcache.aheads,
+         st.bcache.aheadhits);
+  printf("disk reads %lu writes %lu (%lu blocks), in flight %d (most %d)\n",
+         st.disk.nread, st.disk.nwrite, st.disk.nblocks,
+         st.disk.inflight, st.disk.maxinflight);
+  printf("log %d blocks, %d in use: commits %lu checkpoints %lu absorbed %lu\n",
+         st.log.size, st.log.used, st.log.ncommit, st.log.ncheckpoint,
+         st.log.nabsorbed);
+  printf("dcache %d entries: hits %lu misses %lu\n",
+         st.dcache.nentry, st.dcache.hits, st.dcache.misses);
+  exit(0);
+}
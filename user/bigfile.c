@@ -0,0 +1,76 @@
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/fs.h"
+#include "user/user.h"
+
+// Sequential write and read throughput of one large file,
+// most of it in double-indirect blocks. Each block starts
+// with its number, which the read checks.
+// Usage: bigfile [MB]
+
+#define HZ 10  // ticks per second
+
+char buf[8*BSIZE];
+
+int
+main(int argc, char *argv[])
+{
+  int mb = 8, fd, t;
+
+  if(argc > 1)
+    mb = atoi(argv[1]);
+  if(mb < 1 || mb * 1024 > MAXFILE){
+    fprintf(2, "Usage: bigfile [MB (1-%d)]\n", (int)(MAXFILE / 1024));
+    exit(1);
+  }
+  int nblocks = mb * 1024 * 1024 / BSIZE;
+
+  fd = open("bigfile.f", O_CREATE | O_WRONLY | O_TRUNC);
+  if(fd < 0){
+    fprintf(2, "bigfile: cannot create bigfile.f\n");
+    exit(1);
+  }
+  t = uptime();
+  for(int b = 0; b < nblocks; b += sizeof(buf) / BSIZE){
+    for(int i = 0; i < sizeof(buf) / BSIZE; i++)
+      *(int*)(buf + i * BSIZE) = b + i;
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "bigfile: write failed at block %d\n", b);
+      exit(1);
+    }
+  }
+  close(fd);
+  t = uptime() - t;
+  printf("write %d MB in %d ticks", mb, t);
+  if(t > 0)
+    printf(", %d KB/s", mb * 1024 * HZ / t);
+  printf("\n");
+
+  fd = open("bigfile.f", O_RDONLY);
+  if(fd < 0){
+    fprintf(2, "bigfile: cannot open bigfile.f\n");
+    exit(1);
+  }
+  t = uptime();
+  for(int b = 0; b < nblocks; b += sizeof(buf) / BSIZE){
+    if(read(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "bigfile: short read at block %d\n", b);
+      exit(1);
+    }
+    for(int i = 0; i < sizeof(buf) / BSIZE; i++){
+      if(*(int*)(buf + i * BSIZE) != b + i){
+        fprintf(2, "bigfile: block %d has wrong contents\n", b + i);
+        exit(1);
+      }
+    }
+  }
+  close(fd);
+  t = uptime() - t;
+  printf("read %d MB in %d ticks", mb, t);
+  if(t > 0)
+    printf(", %d KB/s", mb * 1024 * HZ / t);
+  printf("\n");
+
+  unlink("bigfile.f");
+  exit(0);
+}
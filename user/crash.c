@@ -237,6 +237,10 @@ main(int argc, char *argv[])
       exit(1);
     }
     input_from_file  = 1;
+  } else {
+    // interactive: respond to keystrokes ahead of batch jobs,
+    // using at most 2 ticks of every 10.
+    setrt(2, 10);
   }
   
   while (1) {
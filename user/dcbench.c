@@ -0,0 +1,76 @@
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+// Path resolution: write a shell script of n commands that
+// each exec echo and open a file a few directories down, run
+// it, and report the time per command and the directory
+// entry cache's hits and misses. Compare with a kernel
+// without the cache. Usage: dcbench [n]
+
+#define HZ 10  // ticks per second
+
+char line[] = "echo hello > dcb/a/b/c/out\n";
+struct iostat st;
+
+int
+main(int argc, char *argv[])
+{
+  int n = 300, fd, pid, t;
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n < 1){
+    fprintf(2, "Usage: dcbench [n]\n");
+    exit(1);
+  }
+
+  mkdir("dcb");
+  mkdir("dcb/a");
+  mkdir("dcb/a/b");
+  mkdir("dcb/a/b/c");
+  fd = open("dcbench.sh", O_CREATE | O_WRONLY | O_TRUNC);
+  if(fd < 0){
+    fprintf(2, "dcbench: cannot create dcbench.sh\n");
+    exit(1);
+  }
+  for(int i = 0; i < n; i++){
+    if(write(fd, line, strlen(line)) != strlen(line)){
+      fprintf(2, "dcbench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+
+  t = uptime();
+  pid = fork();
+  if(pid < 0){
+    fprintf(2, "dcbench: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    char *args[] = { "sh", "dcbench.sh", 0 };
+    exec("sh", args);
+    fprintf(2, "dcbench: exec sh failed\n");
+    exit(1);
+  }
+  wait(0);
+  t = uptime() - t;
+
+  printf("%d commands in %d ticks", n, t);
+  if(t > 0)
+    printf(", %d commands/s", n * HZ / t);
+  printf("\n");
+
+  unlink("dcbench.sh");
+  unlink("dcb/a/b/c/out");
+  unlink("dcb/a/b/c");
+  unlink("dcb/a/b");
+  unlink("dcb/a");
+  unlink("dcb");
+  if(bcachestat(&st) == 0)
+    printf("dcache %d entries: hits %lu misses %lu\n",
+           st.dcache.nentry, st.dcache.hits, st.dcache.misses);
+  exit(0);
+}
@@ -0,0 +1,90 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// Measure fork+exec+exit+wait latency of the UPROGS programs.
+// With demand paging, exec only maps what the new program
+// actually touches, so large binaries that exit early
+// (usertests printing its usage) start about as fast as
+// small ones (echo).
+//
+// Each program runs with its standard input, output and error
+// closed, and with arguments that make it exit at once, often
+// through its usage message. Programs that never exit, wait
+// for the console, shut down the machine, or are benchmarks
+// themselves (sh, init, grind, spinner, quit, reboot, crash,
+// stressfs, forktest, *bench, *stat, ...) are left out.
+//
+// For the numbers before demand paging, build and run this
+// file on the commit before user-030's.
+// Usage: execbench [iterations]
+
+#define ITERS 50
+
+char *progs[][4] = {
+  { "about", 0 },
+  { "cat", 0 },
+  { "catlines1", 0 },
+  { "catlines2", 0 },
+  { "catlines3", 0 },
+  { "echo", "hi", 0 },
+  { "freemem", 0 },
+  { "grep", "x", 0 },
+  { "kill", 0 },
+  { "leetify", 0 },
+  { "ln", 0 },
+  { "ls", 0 },
+  { "mkdir", 0 },
+  { "nice", 0 },
+  { "rm", 0 },
+  { "rtc_time", 0 },
+  { "slabinfo", 0 },
+  { "tolower", 0 },
+  { "usertests", "-x", 0 },
+  { "wc", 0 },
+};
+
+static uint64
+run(char **argv, int iters)
+{
+  uint64 start = time();
+  for(int i = 0; i < iters; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "execbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      close(0);
+      close(1);
+      close(2);
+      exec(argv[0], argv);
+      exit(1);
+    }
+    wait(0);
+  }
+  return time() - start;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int iters = ITERS;
+  uint64 t, total = 0;
+
+  if(argc > 1)
+    iters = atoi(argv[1]);
+  if(iters <= 0){
+    fprintf(2, "usage: execbench [iterations]\n");
+    exit(1);
+  }
+
+  printf("%d iterations, time units per program\n", iters);
+  for(int i = 0; i < sizeof(progs)/sizeof(progs[0]); i++){
+    t = run(progs[i], iters);
+    total += t;
+    printf("%s: %d\n", progs[i][0], (int)t);
+  }
+  printf("total: %d\n", (int)total);
+  exit(0);
+}
@@ -0,0 +1,98 @@
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+// Disk request throughput: n processes at once each read
+// their own file sequentially, so that read-ahead keeps
+// several requests in flight. Build with BCACHEDIV=4096, so
+// that the files do not fit in the cache and every block
+// read is a disk read, and the blocks read per second are
+// the disk's IOPS. Prints the disk counters at the end.
+// Usage: iostress [nproc [passes]]
+
+#define MAXPROC 6
+#define FILESZ  (512*1024)
+#define HZ      10  // ticks per second
+
+char buf[1024];
+struct iostat st;
+
+int
+main(int argc, char *argv[])
+{
+  int nproc = 3, passes = 4;
+  char dir[4] = "io0";
+
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(argc > 2)
+    passes = atoi(argv[2]);
+  if(nproc < 1 || nproc > MAXPROC || passes < 1){
+    fprintf(2, "Usage: iostress [nproc (1-%d) [passes]]\n", MAXPROC);
+    exit(1);
+  }
+
+  memset(buf, 'i', sizeof(buf));
+  for(int i = 0; i < nproc; i++){
+    dir[2] = '0' + i;
+    mkdir(dir);
+    if(chdir(dir) < 0){
+      fprintf(2, "iostress: cannot create %s\n", dir);
+      exit(1);
+    }
+    int fd = open("f", O_CREATE | O_WRONLY | O_TRUNC);
+    if(fd < 0){
+      fprintf(2, "iostress: cannot create %s/f\n", dir);
+      exit(1);
+    }
+    for(int n = 0; n < FILESZ; n += sizeof(buf))
+      write(fd, buf, sizeof(buf));
+    close(fd);
+    chdir("..");
+  }
+
+  int start = uptime();
+  for(int i = 0; i < nproc; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "iostress: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      dir[2] = '0' + i;
+      chdir(dir);
+      for(int p = 0; p < passes; p++){
+        int fd = open("f", O_RDONLY);
+        if(fd < 0)
+          exit(1);
+        while(read(fd, buf, sizeof(buf)) > 0)
+          ;
+        close(fd);
+      }
+      exit(0);
+    }
+  }
+  for(int i = 0; i < nproc; i++)
+    wait(0);
+  int t = uptime() - start;
+
+  for(int i = 0; i < nproc; i++){
+    dir[2] = '0' + i;
+    chdir(dir);
+    unlink("f");
+    chdir("..");
+    unlink(dir);
+  }
+
+  int blocks = nproc * passes * (FILESZ / 1024);
+  printf("%d readers: %d blocks in %d ticks", nproc, blocks, t);
+  if(t > 0)
+    printf(", %d IOPS", blocks * HZ / t);
+  printf("\n");
+  if(bcachestat(&st) == 0)
+    printf("disk reads %lu writes %lu (%lu blocks), most in flight %d\n",
+           st.disk.nread, st.disk.nwrite, st.disk.nblocks,
+           st.disk.maxinflight);
+  exit(0);
+}
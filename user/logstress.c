@@ -1,21 +1,26 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/iostat.h"
 #include "user/user.h"
 
 // Stress xv6 logging system by having several processes writing
-// concurrently to their own file (e.g., logstress f1 f2 f3 f4)
+// concurrently to their own file (e.g., logstress f1 f2 f3 f4),
+// and report the total write throughput and log counters.
 
-#define BUFSZ 500
+#define HZ 10  // ticks per second
 
-char buf[BUFSZ];
+enum { N = 250, SZ=2000 };
+
+char buf[SZ];
+struct iostat st;
 
 int
 main(int argc, char **argv)
 {
   int fd, n;
-  enum { N = 250, SZ=2000 };
-  
+  int start = uptime();
+
   for (int i = 1; i < argc; i++){
     int pid1 = fork();
     if(pid1 < 0){
@@ -44,5 +49,15 @@ main(int argc, char **argv)
     if(xstatus != 0)
       exit(xstatus);
   }
+  int t = uptime() - start;
+  int kb = (argc - 1) * N * SZ / 1024;
+  printf("%d writers: %d KB in %d ticks", argc - 1, kb, t);
+  if(t > 0)
+    printf(", %d KB/s", kb * HZ / t);
+  printf("\n");
+  if(bcachestat(&st) == 0)
+    printf("log %d blocks: commits %lu checkpoints %lu absorbed %lu\n",
+           st.log.size, st.log.ncommit, st.log.ncheckpoint,
+           st.log.nabsorbed);
   return 0;
 }
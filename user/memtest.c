@@ -1,5 +1,6 @@
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/fcntl.h"
 #include "user/user.h"
 
 int
@@ -7,9 +8,11 @@ main(int argc, char *argv[])
 {
   // 1. Start up
   // 2. Create three mapped memory pages
-  char *addr1 = mmap();
-  char *addr2 = mmap();
-  char *addr3 = mmap();
+  int prot = PROT_READ | PROT_WRITE;
+  int flags = MAP_SHARED | MAP_ANONYMOUS;
+  char *addr1 = mmap(0, 4096, prot, flags, -1, 0);
+  char *addr2 = mmap(0, 4096, prot, flags, -1, 0);
+  char *addr3 = mmap(0, 4096, prot, flags, -1, 0);
   
   // 3. Store test strings in each of the pages and print them
   strcpy(addr1, "Hello World!");
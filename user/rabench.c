@@ -0,0 +1,75 @@
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/iostat.h"
+#include "user/user.h"
+
+// Sequential read throughput with the read sizes of catlines1,
+// catlines2 and catlines3 (64, 512 and 2048 bytes), over one
+// file much larger than a small buffer cache. Build with
+// BCACHEDIV=4096 so that the cache is NBUF blocks and every
+// pass reads from the disk, then compare a kernel built with
+// RAMAX=0 (no read-ahead) against the default.
+// Usage: rabench [passes]
+
+#define FILESZ (1024*1024)
+#define HZ     10  // ticks per second
+
+char buf[2048];
+int sizes[] = { 64, 512, 2048 };
+struct iostat st;
+
+int
+main(int argc, char *argv[])
+{
+  int passes = 4;
+
+  if(argc > 1)
+    passes = atoi(argv[1]);
+  if(passes < 1){
+    fprintf(2, "Usage: rabench [passes]\n");
+    exit(1);
+  }
+
+  int fd = open("rabench.f", O_CREATE | O_WRONLY | O_TRUNC);
+  if(fd < 0){
+    fprintf(2, "rabench: cannot create rabench.f\n");
+    exit(1);
+  }
+  memset(buf, 'a', sizeof(buf));
+  for(int n = 0; n < FILESZ; n += sizeof(buf)){
+    if(write(fd, buf, sizeof(buf)) != sizeof(buf)){
+      fprintf(2, "rabench: write failed\n");
+      exit(1);
+    }
+  }
+  close(fd);
+
+  for(int i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++){
+    int start = uptime();
+    for(int p = 0; p < passes; p++){
+      fd = open("rabench.f", O_RDONLY);
+      if(fd < 0){
+        fprintf(2, "rabench: cannot open rabench.f\n");
+        exit(1);
+      }
+      while(read(fd, buf, sizes[i]) > 0)
+        ;
+      close(fd);
+    }
+    int t = uptime() - start;
+    int kb = passes * (FILESZ / 1024);
+    printf("catlines%d (%d-byte reads): %d KB in %d ticks", i + 1,
+           sizes[i], kb, t);
+    if(t > 0)
+      printf(", %d.%d MB/s", kb * HZ / t / 1024, kb * HZ / t % 1024 * 10 / 1024);
+    printf("\n");
+  }
+
+  unlink("rabench.f");
+  if(bcachestat(&st) == 0){
+    printf("hits %lu misses %lu\n", st.bcache.hits, st.bcache.misses);
+    printf("read ahead %lu, used %lu\n", st.bcache.aheads,
+           st.bcache.aheadhits);
+  }
+  exit(0);
+}
@@ -0,0 +1,92 @@
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+// Buffer cache scalability: n processes, each pinned to its
+// own hart where possible, repeatedly read their own small
+// file, which stays in the buffer cache. Each file sits in
+// its own directory so that the opens do not all lock the
+// root directory. Run with n = 1, 2, 3 and compare the total
+// throughput. Usage: readbench [nproc [rounds]]
+
+#define MAXPROC 6
+#define FILESZ  (4*1024)  // four blocks per file, so all fit in the cache
+
+char buf[1024];
+
+int
+main(int argc, char *argv[])
+{
+  int nproc = 2, rounds = 500;
+  char dir[4] = "rb0";
+
+  if(argc > 1)
+    nproc = atoi(argv[1]);
+  if(argc > 2)
+    rounds = atoi(argv[2]);
+  if(nproc < 1 || nproc > MAXPROC || rounds < 1){
+    fprintf(2, "Usage: readbench [nproc (1-%d) [rounds]]\n", MAXPROC);
+    exit(1);
+  }
+
+  memset(buf, 'r', sizeof(buf));
+  for(int i = 0; i < nproc; i++){
+    dir[2] = '0' + i;
+    mkdir(dir);
+    if(chdir(dir) < 0){
+      fprintf(2, "readbench: cannot create %s\n", dir);
+      exit(1);
+    }
+    int fd = open("f", O_CREATE | O_WRONLY | O_TRUNC);
+    if(fd < 0){
+      fprintf(2, "readbench: cannot create %s/f\n", dir);
+      exit(1);
+    }
+    for(int n = 0; n < FILESZ; n += sizeof(buf))
+      write(fd, buf, sizeof(buf));
+    close(fd);
+    chdir("..");
+  }
+
+  int start = uptime();
+  for(int i = 0; i < nproc; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "readbench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      // fails harmlessly if there are fewer harts.
+      setaffinity(0, 1 << i);
+      dir[2] = '0' + i;
+      chdir(dir);
+      for(int r = 0; r < rounds; r++){
+        int fd = open("f", O_RDONLY);
+        if(fd < 0)
+          exit(1);
+        while(read(fd, buf, sizeof(buf)) > 0)
+          ;
+        close(fd);
+      }
+      exit(0);
+    }
+  }
+  for(int i = 0; i < nproc; i++)
+    wait(0);
+  int t = uptime() - start;
+
+  for(int i = 0; i < nproc; i++){
+    dir[2] = '0' + i;
+    chdir(dir);
+    unlink("f");
+    chdir("..");
+    unlink(dir);
+  }
+
+  int kb = nproc * rounds * (FILESZ / 1024);
+  printf("%d procs: %d KB in %d ticks", nproc, kb, t);
+  if(t > 0)
+    printf(", %d KB/tick", kb / t);
+  printf("\n");
+  exit(0);
+}
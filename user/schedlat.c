@@ -0,0 +1,67 @@
+#include "kernel/types.h"
+#include "user/user.h"
+
+// Scheduling latency: two processes bounce a byte over a pair
+// of pipes, so every round trip is two wakeups and two trips
+// through the scheduler. Background spinners (at the lowest
+// priority) keep the run queues non-empty.
+
+#define ROUNDS 1000
+#define MAXSPIN 16
+
+int
+main(int argc, char *argv[])
+{
+  int nspin = 4;
+  int rounds = ROUNDS;
+  int spin[MAXSPIN];
+  int ping[2], pong[2];
+  char b = 0;
+
+  if(argc > 1)
+    nspin = atoi(argv[1]);
+  if(argc > 2)
+    rounds = atoi(argv[2]);
+  if(nspin < 0 || nspin > MAXSPIN || rounds <= 0){
+    fprintf(2, "Usage: schedlat [spinners] [rounds]\n");
+    exit(1);
+  }
+
+  for(int i = 0; i < nspin; i++){
+    if((spin[i] = fork()) == 0){
+      nice(3);
+      for(;;)
+        ;
+    }
+  }
+
+  if(pipe(ping) < 0 || pipe(pong) < 0){
+    fprintf(2, "schedlat: pipe failed\n");
+    exit(1);
+  }
+  int pid = fork();
+  if(pid == 0){
+    for(int i = 0; i < rounds; i++){
+      read(ping[0], &b, 1);
+      write(pong[1], &b, 1);
+    }
+    exit(0);
+  }
+
+  int start = time();
+  for(int i = 0; i < rounds; i++){
+    write(ping[1], &b, 1);
+    read(pong[0], &b, 1);
+  }
+  int t = time() - start;
+  wait(0);
+
+  for(int i = 0; i < nspin; i++){
+    kill(spin[i]);
+    wait(0);
+  }
+
+  printf("%d spinners, %d round trips\n", nspin, rounds);
+  printf("%d time units per round trip\n", t / rounds);
+  exit(0);
+}
@@ -0,0 +1,63 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/schedstat.h"
+#include "user/user.h"
+
+// Print per-hart run queue lengths and scheduler counters.
+// With an argument n, first run n CPU-bound children for a
+// while so there is something to balance across harts.
+
+#define MAXKIDS 16
+
+struct schedstat st[NCPU];
+
+static void
+print(void)
+{
+  int n;
+
+  if((n = schedstat(st, NCPU)) < 0){
+    fprintf(2, "schedstat: schedstat failed\n");
+    exit(1);
+  }
+  printf("hart queued   sched   steals  migrations\n");
+  for(int i = 0; i < n; i++){
+    if(st[i].nsched == 0 && st[i].nrunnable == 0)
+      continue;
+    printf("%d\t%d\t%lu\t%lu\t%lu%s\n", i, st[i].nrunnable,
+           st[i].nsched, st[i].steals, st[i].migrations,
+           st[i].idle ? "\tidle" : "");
+  }
+  printf("quantum (priority %d..0):", NPRIO-1);
+  for(int q = NPRIO-1; q >= 0; q--)
+    printf(" %d", quantum(q, 0));
+  printf("\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+  int pids[MAXKIDS];
+  int n = 0;
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n > MAXKIDS)
+    n = MAXKIDS;
+
+  for(int i = 0; i < n; i++){
+    if((pids[i] = fork()) == 0){
+      for(;;)
+        ;
+    }
+  }
+  if(n > 0)
+    pause(20);
+  print();
+  for(int i = 0; i < n; i++){
+    kill(pids[i]);
+    wait(0);
+  }
+  exit(0);
+}
@@ -0,0 +1,107 @@
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/param.h"
+#include "kernel/schedtrace.h"
+#include "user/user.h"
+
+// Drain the kernel's scheduler event trace into a file for
+// offline analysis, for the given number of ticks, and print
+// a summary of run-queue latency (wakeup to switch-in).
+// Usage: schedtrace file [ticks]
+
+#define NEV 256
+
+struct schedevent buf[NEV];
+
+// time of the pending wakeup for each process slot.
+struct {
+  int pid;
+  uint64 time;
+} woke[NPROC];
+
+uint64 nlat, sumlat, maxlat;
+
+// Sort a batch by time; harts are drained one after another.
+static void
+sort(struct schedevent *e, int n)
+{
+  for(int i = 1; i < n; i++){
+    struct schedevent t = e[i];
+    int j = i;
+    for(; j > 0 && e[j-1].time > t.time; j--)
+      e[j] = e[j-1];
+    e[j] = t;
+  }
+}
+
+static void
+account(struct schedevent *e)
+{
+  int i, free = -1;
+
+  for(i = 0; i < NPROC; i++){
+    if(woke[i].pid == e->pid)
+      break;
+    if(woke[i].pid == 0 && free < 0)
+      free = i;
+  }
+  if(e->type == SE_WAKEUP){
+    if(i == NPROC)
+      i = free;
+    if(i >= 0){
+      woke[i].pid = e->pid;
+      woke[i].time = e->time;
+    }
+  } else if(e->type == SE_SWITCHIN && i < NPROC){
+    uint64 lat = e->time - woke[i].time;
+    nlat++;
+    sumlat += lat;
+    if(lat > maxlat)
+      maxlat = lat;
+    woke[i].pid = 0;
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int ticks = 100;
+  int fd, n, total = 0;
+
+  if(argc < 2){
+    fprintf(2, "Usage: schedtrace file [ticks]\n");
+    exit(1);
+  }
+  if(argc > 2)
+    ticks = atoi(argv[2]);
+  if((fd = open(argv[1], O_CREATE | O_WRONLY | O_TRUNC)) < 0){
+    fprintf(2, "schedtrace: cannot open %s\n", argv[1]);
+    exit(1);
+  }
+
+  // throw away whatever happened before we started.
+  while(schedtrace(buf, NEV) > 0)
+    ;
+
+  int end = uptime() + ticks;
+  while(uptime() < end){
+    pause(1);
+    while((n = schedtrace(buf, NEV)) > 0){
+      sort(buf, n);
+      for(int i = 0; i < n; i++)
+        account(&buf[i]);
+      if(write(fd, buf, n * sizeof(buf[0])) != n * sizeof(buf[0])){
+        fprintf(2, "schedtrace: write failed\n");
+        exit(1);
+      }
+      total += n;
+    }
+  }
+  close(fd);
+
+  printf("%d events written to %s\n", total, argv[1]);
+  if(nlat > 0)
+    printf("run-queue latency: %d wakeups, avg %d, max %d cycles\n",
+           (int)nlat, (int)(sumlat / nlat), (int)maxlat);
+  exit(0);
+}
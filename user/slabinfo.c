@@ -0,0 +1,69 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/riscv.h"
+#include "kernel/slabstat.h"
+#include "user/user.h"
+
+// Print the kernel slab caches. With an argument n, first open
+// n pipes and report how much memory each one cost.
+
+#define MAXPIPES 6  // two fds each, within NOFILE
+#define MAXCACHE 8
+
+struct slabstat st[MAXCACHE];
+
+// Print every cache's usage and the memory saved compared
+// to giving each object its own page.
+static void
+print(void)
+{
+  int n;
+
+  if((n = slabinfo(st, MAXCACHE)) < 0){
+    fprintf(2, "slabinfo: slabinfo failed\n");
+    exit(1);
+  }
+  printf("cache      objsize perslab active slabs saved/obj saved\n");
+  for(int i = 0; i < n; i++){
+    uint64 saved = 0;
+    if(st[i].active > st[i].nslabs)
+      saved = (uint64)(st[i].active - st[i].nslabs) * PGSIZE;
+    printf("%s\t%d\t%d\t%d\t%d\t%d\t%ld\n", st[i].name, st[i].objsize,
+           st[i].perslab, st[i].active, st[i].nslabs,
+           PGSIZE - PGSIZE / st[i].perslab, saved);
+  }
+}
+
+int
+main(int argc, char *argv[])
+{
+  int fds[MAXPIPES][2];
+  int n = 0;
+
+  if(argc > 1)
+    n = atoi(argv[1]);
+  if(n > MAXPIPES)
+    n = MAXPIPES;
+
+  int before = freemem();
+  for(int i = 0; i < n; i++){
+    if(pipe(fds[i]) < 0){
+      fprintf(2, "slabinfo: pipe %d failed\n", i);
+      n = i;
+      break;
+    }
+  }
+  int after = freemem();
+
+  print();
+
+  if(n > 0){
+    printf("%d pipes used %d KiB (%d KiB with a page per pipe)\n",
+           n, before - after, n * 4);
+    for(int i = 0; i < n; i++){
+      close(fds[i][0]);
+      close(fds[i][1]);
+    }
+  }
+  exit(0);
+}
@@ -0,0 +1,79 @@
+#include "kernel/types.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+// Run one stride-class spinner at each nice level for a fixed
+// time and compare the share of the work each one got with
+// its share of the tickets (4:3:2:1 for nice 0..3).
+// Shares are kept per hart, so run with CPUS=1 for an exact
+// comparison.
+
+#define NWORKERS 4
+#define DURATION 100  // ticks
+
+struct result {
+  int worker;
+  uint64 count;
+};
+
+int
+main(int argc, char *argv[])
+{
+  int fds[2];
+  uint64 count[NWORKERS], total = 0;
+  int duration = DURATION;
+
+  if(argc > 1)
+    duration = atoi(argv[1]);
+  if(pipe(fds) < 0){
+    fprintf(2, "stridebench: pipe failed\n");
+    exit(1);
+  }
+
+  int end = uptime() + duration;
+  for(int i = 0; i < NWORKERS; i++){
+    int pid = fork();
+    if(pid < 0){
+      fprintf(2, "stridebench: fork failed\n");
+      exit(1);
+    }
+    if(pid == 0){
+      struct result r = { i, 0 };
+      setsched(SCHED_STRIDE);
+      nice(i);
+      for(;;){
+        r.count++;
+        if((r.count & 0xffff) == 0 && uptime() >= end)
+          break;
+      }
+      // one write, so results from workers do not interleave.
+      write(fds[1], &r, sizeof(r));
+      exit(0);
+    }
+  }
+  close(fds[1]);
+
+  for(int i = 0; i < NWORKERS; i++){
+    struct result r;
+    if(read(fds[0], &r, sizeof(r)) != sizeof(r) ||
+       r.worker < 0 || r.worker >= NWORKERS){
+      fprintf(2, "stridebench: bad result\n");
+      exit(1);
+    }
+    count[r.worker] = r.count;
+    total += r.count;
+  }
+  for(int i = 0; i < NWORKERS; i++)
+    wait(0);
+
+  if(total == 0)
+    total = 1;
+  int tsum = NWORKERS * (NWORKERS + 1) / 2;
+  printf("nice tickets target got\n");
+  for(int i = 0; i < NWORKERS; i++){
+    int tickets = NWORKERS - i;
+    printf("%d    %d     %d%%    %d%%\n", i, tickets * 100,
+           tickets * 100 / tsum, (int)(count[i] * 100 / total));
+  }
+  exit(0);
+}
@@ -0,0 +1,45 @@
+#include "kernel/types.h"
+#include "user/user.h"
+
+// Run a command pinned to a set of harts, given as a comma
+// separated list: taskset 0,2 spinner a 100
+
+int
+main(int argc, char *argv[])
+{
+  if (argc < 3) {
+    fprintf(2, "Usage: taskset <cpu>[,<cpu>...] <command> [args...]\n");
+    exit(1);
+  }
+
+  int mask = 0;
+  char *s = argv[1];
+  while (*s) {
+    if (*s < '0' || *s > '9') {
+      fprintf(2, "taskset: bad cpu list %s\n", argv[1]);
+      exit(1);
+    }
+    int cpu = atoi(s);
+    if (cpu >= 31) {
+      fprintf(2, "taskset: bad cpu %d\n", cpu);
+      exit(1);
+    }
+    mask |= 1 << cpu;
+    while (*s >= '0' && *s <= '9')
+      s++;
+    if (*s == ',')
+      s++;
+  }
+
+  // Pin this process; the command inherits it across exec
+  if (setaffinity(0, mask) < 0) {
+    fprintf(2, "taskset: no online cpu in %s\n", argv[1]);
+    exit(1);
+  }
+  
+  exec(argv[2], &argv[2]);
+  
+  // If exec returns, it failed
+  fprintf(2, "taskset: exec %s failed\n", argv[2]);
+  exit(1);
+}
@@ -0,0 +1,63 @@
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+// Stream through a large heap buffer mapped two ways and
+// compare: once grown a page at a time (4KB mappings) and
+// once grown in one 2MB-aligned sbrk (megapage mappings).
+// Touching one word per page makes the loop TLB-miss bound.
+
+#define MB (1024*1024)
+#define SUPERPG (2*MB)
+#define PASSES 20
+
+static uint64
+stream(char *buf, int len)
+{
+  uint64 start = time();
+  for(int pass = 0; pass < PASSES; pass++)
+    for(int off = 0; off < len; off += 4096)
+      buf[off]++;
+  return time() - start;
+}
+
+int
+main(int argc, char *argv[])
+{
+  int mb = 8;
+  if(argc > 1)
+    mb = atoi(argv[1]);
+  int len = mb * MB;
+
+  // 4KB pages: each sbrk() maps a single page.
+  char *small = sbrk(0);
+  for(int i = 0; i < len; i += 4096){
+    if(sbrk(4096) == SBRK_ERROR){
+      fprintf(2, "tlbbench: out of memory\n");
+      exit(1);
+    }
+  }
+
+  // megapages: align the break, then grow in one step.
+  uint64 brk = (uint64)sbrk(0);
+  uint64 pad = ((brk + SUPERPG - 1) & ~(uint64)(SUPERPG - 1)) - brk;
+  if(sbrk(pad) == SBRK_ERROR){
+    fprintf(2, "tlbbench: out of memory\n");
+    exit(1);
+  }
+  char *big = sbrk(len);
+  if(big == SBRK_ERROR){
+    fprintf(2, "tlbbench: out of memory\n");
+    exit(1);
+  }
+
+  uint64 t4k = stream(small, len);
+  uint64 t2m = stream(big, len);
+
+  printf("%d MB x %d passes\n", mb, PASSES);
+  printf("4KB pages: %d time units\n", (int)t4k);
+  printf("2MB pages: %d time units\n", (int)t2m);
+  if(t2m > 0)
+    printf("speedup: %d.%dx\n", (int)(t4k / t2m), (int)((t4k * 10 / t2m) % 10));
+  exit(0);
+}
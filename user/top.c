@@ -0,0 +1,75 @@
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/pstat.h"
+#include "user/user.h"
+
+// Show which processes use the harts: every interval ticks,
+// print each process's share of a hart over that interval
+// along with its totals. Usage: top [interval [count]]
+
+struct pstat prev[NPROC], cur[NPROC];
+
+static char *states[] = {
+  "unused", "used", "sleep", "runble", "run", "zombie"
+};
+
+// prev entry for pid, or 0 if it is new.
+static struct pstat*
+lookup(int pid, int n)
+{
+  for(int i = 0; i < n; i++)
+    if(prev[i].pid == pid)
+      return &prev[i];
+  return 0;
+}
+
+// print a cycle count as ticks
+static void
+pticks(uint64 cycles)
+{
+  printf("%d", (int)(cycles / TICKCYCLES));
+}
+
+int
+main(int argc, char *argv[])
+{
+  int interval = 10, count = 5;
+
+  if(argc > 1)
+    interval = atoi(argv[1]);
+  if(argc > 2)
+    count = atoi(argv[2]);
+  if(interval <= 0){
+    fprintf(2, "Usage: top [interval [count]]\n");
+    exit(1);
+  }
+
+  int nprev = procstat(prev, NPROC);
+  for(int r = 0; r < count; r++){
+    pause(interval);
+    int n = procstat(cur, NPROC);
+    if(n < 0 || nprev < 0){
+      fprintf(2, "top: procstat failed\n");
+      exit(1);
+    }
+
+    printf("\nPID\tPPID\tSTATE\tPRI NI CPU\t%%CPU\tRUN\tWAIT\tVCSW\tIVCSW\tFAULTS\tMEM\tNAME\n");
+    for(int i = 0; i < n; i++){
+      struct pstat *s = &cur[i], *o = lookup(s->pid, nprev);
+      uint64 ran = s->rtime - (o ? o->rtime : 0);
+      int pct = (int)(ran * 100 / ((uint64)interval * TICKCYCLES));
+      char *st = s->state >= 0 && s->state < 6 ? states[s->state] : "?";
+
+      printf("%d\t%d\t%s\t%d  %d  %d\t%d\t", s->pid, s->ppid, st,
+             s->priority, s->nice, s->cpu, pct);
+      pticks(s->rtime);
+      printf("\t");
+      pticks(s->wtime);
+      printf("\t%d\t%d\t%d\t%dK\t%s\n", (int)s->nvcsw, (int)s->nivcsw,
+             (int)s->nfaults, (int)(s->sz / 1024), s->name);
+    }
+    memmove(prev, cur, sizeof(cur[0]) * n);
+    nprev = n;
+  }
+  exit(0);
+}
@@ -2,6 +2,11 @@
 
 typedef unsigned int uint;
 struct stat;
+struct pstat;
+struct slabstat;
+struct schedstat;
+struct schedevent;
+struct iostat;
 
 // system calls
 int fork(void);
@@ -33,7 +38,19 @@ int stracing(void);
 int time(void);
 int nice(int);
 int freemem(void);
-void* mmap(void);
+void* mmap(void*, int, int, int, int, int);
+int munmap(void*, int);
+int schedstat(struct schedstat*, int);
+int setsched(int);
+int quantum(int, int);
+int wakestat(uint64*);
+int procstat(struct pstat*, int);
+int schedtrace(struct schedevent*, int);
+int setrt(int, int);
+int setaffinity(int, int);
+int getaffinity(int);
+int bcachestat(struct iostat*);
+int slabinfo(struct slabstat*, int);
 
 // ulib.c
 int stat(const char*, struct stat*);
@@ -874,6 +874,82 @@ preempt(char *s)
   wait(0);
 }
 
+// a real-time process spinning on a hart must leave some of
+// every period to the other processes there.
+void
+rtshare(char *s)
+{
+  int pid1, pid2, seen, last, now, done, killed;
+  int pfds[2];
+
+  pid1 = fork();
+  if(pid1 < 0) {
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid1 == 0){
+    if(setrt(10, 10) != -1){
+      printf("%s: setrt allowed budget == period\n", s);
+      exit(1);
+    }
+    exit(0);
+  }
+  wait(&done);
+  if(done != 0)
+    exit(1);
+
+  pid1 = fork();
+  if(pid1 < 0) {
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid1 == 0){
+    setaffinity(0, 1);
+    setrt(5, 10);
+    for(;;)
+      ;
+  }
+
+  pipe(pfds);
+  pid2 = fork();
+  if(pid2 < 0) {
+    printf("%s: fork failed\n", s);
+    exit(1);
+  }
+  if(pid2 == 0){
+    // count ticks seen while running on the same hart.
+    close(pfds[0]);
+    setaffinity(0, 1);
+    seen = 0;
+    last = uptime();
+    while(seen < 10){
+      if((now = uptime()) != last){
+        seen++;
+        last = now;
+      }
+    }
+    done = uptime();
+    write(pfds[1], &done, sizeof(done));
+    exit(0);
+  }
+
+  close(pfds[1]);
+  pause(200);
+  killed = uptime();
+  kill(pid1);
+  if(read(pfds[0], &done, sizeof(done)) != sizeof(done)){
+    printf("%s: read error\n", s);
+    exit(1);
+  }
+  close(pfds[0]);
+  wait(0);
+  wait(0);
+  if(done >= killed){
+    printf("%s: real-time process starved the hart\n", s);
+    exit(1);
+  }
+}
+
 // try to find any races between exit and wait
 void
 exitwait(char *s)
@@ -2723,6 +2799,7 @@ struct test {
   {pipe1, "pipe1"},
   {killstatus, "killstatus"},
   {preempt, "preempt"},
+  {rtshare, "rtshare"},
   {exitwait, "exitwait"},
   {reparent, "reparent" },
   {twochildren, "twochildren"},
@@ -51,4 +51,16 @@ entry("time");
 entry("nice");
 entry("freemem");
 entry("mmap");
+entry("slabinfo");
+entry("munmap");
+entry("schedstat");
+entry("setsched");
+entry("quantum");
+entry("wakestat");
+entry("procstat");
+entry("schedtrace");
+entry("setrt");
+entry("setaffinity");
+entry("getaffinity");
+entry("bcachestat");
 
@@ -0,0 +1,43 @@
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+// Run a command and report what its wakeup() calls cost,
+// e.g. wakestat logstress f1 f2 f3 f4. A wakeup() that scans
+// the whole process table would examine NPROC processes per
+// call; hashed wait queues examine only the sleepers whose
+// channel hashes to the same queue.
+
+int
+main(int argc, char *argv[])
+{
+  uint64 before[3], after[3];
+
+  if(argc < 2){
+    fprintf(2, "Usage: wakestat command [args...]\n");
+    exit(1);
+  }
+
+  wakestat(before);
+  int pid = fork();
+  if(pid < 0){
+    fprintf(2, "wakestat: fork failed\n");
+    exit(1);
+  }
+  if(pid == 0){
+    exec(argv[1], &argv[1]);
+    fprintf(2, "wakestat: exec %s failed\n", argv[1]);
+    exit(1);
+  }
+  wait(0);
+  wakestat(after);
+
+  uint64 calls = after[0] - before[0];
+  uint64 examined = after[1] - before[1];
+  uint64 woken = after[2] - before[2];
+  printf("wakeup calls:      %d\n", (int)calls);
+  printf("sleepers examined: %d (full scan: %d)\n",
+         (int)examined, (int)(calls * NPROC));
+  printf("sleepers woken:    %d\n", (int)woken);
+  exit(0);
+}